@@ -2,18 +2,92 @@
 
 #define internal static
 #define global static
+#if defined(_WIN32)
+#define AR_PLATFORM_WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#define VKAPI_CALL __stdcall
+#elif defined(AR_PLATFORM_WAYLAND)
+#define VK_USE_PLATFORM_WAYLAND_KHR
+#define VKAPI_CALL
+#else
+#define AR_PLATFORM_XCB
+#define VK_USE_PLATFORM_XCB_KHR
+#define VKAPI_CALL
+#endif
+#if defined(AR_PLATFORM_XCB) || defined(AR_PLATFORM_WAYLAND)
+#define AR_PLATFORM_POSIX
+#endif
 #define VK_NO_PROTOTYPES
 #define WIN32_LEAN_AND_MEAN
 #define VKAPI_ATTR
-#define VKAPI_CALL __stdcall
 #define VKAPI_PTR VKAPI_CALL
 #include <stdbool.h>
+#if defined(AR_PLATFORM_WIN32)
 #include <windows.h>
 #include <dwmapi.h>
 #include <hidusage.h>
 #include "vulkan/vulkan_core.h"
 #include "vulkan/vulkan_win32.h"
+#define AR_SURFACE_EXTENSION_NAME VK_KHR_WIN32_SURFACE_EXTENSION_NAME
+#elif defined(AR_PLATFORM_POSIX)
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(AR_PLATFORM_XCB)
+#include <xcb/xcb.h>
+#include <xcb/xinput.h>
+#include "vulkan/vulkan_core.h"
+#include "vulkan/vulkan_xcb.h"
+#define AR_SURFACE_EXTENSION_NAME VK_KHR_XCB_SURFACE_EXTENSION_NAME
+#elif defined(AR_PLATFORM_WAYLAND)
+#include <poll.h>
+#undef global
+#include <wayland-client.h>
+#include <wayland-cursor.h>
+#include "xdg-shell-client-protocol.h"
+#define global static
+#include "vulkan/vulkan_core.h"
+#include "vulkan/vulkan_wayland.h"
+#define AR_SURFACE_EXTENSION_NAME VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME
+#endif
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define AR_HEADLESS_IMAGE_COUNT 3
+#define AR_MAX_FRAMES_IN_FLIGHT 4
+#define AR_DEFAULT_TRANSIENT_MEMORY_SIZE (4 << 20)
+#define AR_MEMORY_MIN_ALIGNMENT 256
+#define AR_MEMORY_BLOCK_SIZE ((VkDeviceSize)64 << 20)
+#define AR_MEMORY_LARGE_BLOCK_SIZE ((VkDeviceSize)256 << 20)
+#define AR_MEMORY_BAR_SIZE ((VkDeviceSize)256 << 20)
+#define AR_MEMORY_USAGE_COUNT 5
+#define AR_MEMORY_CATEGORY_COUNT 4
+#define AR_TLSF_SL_LOG2 4
+#define AR_TLSF_SL_COUNT (1 << AR_TLSF_SL_LOG2)
+#define AR_TLSF_FL_COUNT 32
+#define AR_FRAME_CALLBACK_TIMEOUT 250
+#define AR_STAGING_SIZE ((VkDeviceSize)64 << 20)
+#define AR_STAGING_CHUNK_SIZE (AR_STAGING_SIZE / 2)
+#define AR_STAGING_ALIGNMENT 16
+#define AR_TRANSFER_SLOT_COUNT 8
+#define AR_FRAME_POOL_RELEASE_INTERVAL 1024
+#define AR_MAX_RECORDING_THREADS 64
+#define AR_MAX_PARALLEL_SECTIONS 8
+#define AR_MAX_JOB_THREADS AR_MAX_RECORDING_THREADS
+#define AR_JOB_QUEUE_SIZE 1024
+#define AR_JOB_SPIN_COUNT 64
+#define AR_MAX_RETIRED_SWAPCHAINS 4
+#define AR_MAX_TRANSIENT_SLOTS 8
+#define AR_PRESENT_WAIT_TIMEOUT 100000000
+#define AR_FRAME_SPIN_TIME 0.001
 
 typedef struct
 {
@@ -21,9 +95,182 @@ typedef struct
     VkCommandBuffer presentCmd;
     VkImage image;
     VkImageView view;
+    VkSemaphore renSemaphore;
+    VkSemaphore preSemaphore;
+    uint64_t frame;
 }
 ArFrame;
 
+// A replaced swapchain lives on until the frames that used it have completed.
+typedef struct
+{
+    VkSwapchainKHR swapchain;
+    VkCommandPool graphicsCommandPool;
+    VkCommandPool presentCommandPool;
+    VkImageView views[6];
+    VkSemaphore renSemaphores[6];
+    VkSemaphore preSemaphores[6];
+    VkCommandPool recordingPools[AR_MAX_RECORDING_THREADS];
+    uint32_t imageCount;
+    uint64_t frame;
+}
+ArRetiredSwapchain;
+
+typedef struct
+{
+    VkCommandPool pool;
+    VkCommandBuffer cmd;
+    VkCommandPool acquirePool;
+    VkCommandBuffer acquireCmd;
+    VkDeviceSize stagingEnd;
+    uint64_t value;
+}
+ArTransfer;
+
+typedef enum
+{
+    AR_COMMAND_BEGIN_RENDERING,
+    AR_COMMAND_END_RENDERING,
+    AR_COMMAND_PUSH_CONSTANTS,
+    AR_COMMAND_BIND_INDEX_BUFFER,
+    AR_COMMAND_BIND_PIPELINE,
+    AR_COMMAND_PIPELINE_BARRIER,
+    AR_COMMAND_DRAW,
+    AR_COMMAND_DRAW_INDIRECT,
+    AR_COMMAND_DRAW_INDIRECT_COUNT,
+    AR_COMMAND_DRAW_INDEXED,
+    AR_COMMAND_DRAW_INDEXED_INDIRECT,
+    AR_COMMAND_DRAW_INDEXED_INDIRECT_COUNT,
+    AR_COMMAND_EXECUTE_COMMANDS
+}
+ArCommandType;
+
+// Every command is a header followed by its payload, padded to 8 bytes.
+// Null image and view handles stand for the swapchain image and are patched on replay.
+typedef struct
+{
+    uint32_t type;
+    uint32_t size;
+}
+ArCommand;
+
+typedef struct
+{
+    VkExtent2D extent;
+    VkRenderingFlags flags;
+    uint32_t colorAttachmentCount;
+    uint32_t hasDepthAttachment;
+    VkRenderingAttachmentInfo depthAttachment;
+    VkRenderingAttachmentInfo colorAttachments[8];
+}
+ArCommandBeginRendering;
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t size;
+    uint8_t values[128];
+}
+ArCommandPushConstants;
+
+typedef struct
+{
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkIndexType indexType;
+}
+ArCommandBindIndexBuffer;
+
+typedef struct
+{
+    VkPipeline pipeline;
+}
+ArCommandBindPipeline;
+
+typedef struct
+{
+    uint32_t barrierCount;
+    VkImageMemoryBarrier2 barriers[8];
+}
+ArCommandPipelineBarrier;
+
+typedef struct
+{
+    uint32_t vertexCount;
+    uint32_t instanceCount;
+    uint32_t firstVertex;
+    uint32_t firstInstance;
+}
+ArCommandDraw;
+
+typedef struct
+{
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkBuffer countBuffer;
+    VkDeviceSize countBufferOffset;
+    uint32_t drawCount;
+    uint32_t stride;
+}
+ArCommandDrawIndirect;
+
+typedef struct
+{
+    uint32_t indexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+}
+ArCommandDrawIndexed;
+
+typedef struct
+{
+    uint32_t commandBufferCount;
+    VkCommandBuffer commandBuffers[AR_MAX_RECORDING_THREADS];
+}
+ArCommandExecuteCommands;
+
+typedef struct
+{
+    char* pData;
+    size_t size;
+    size_t capacity;
+}
+ArCommandStream;
+
+// Each recording thread owns one pool per frame slot, plus one set for pre-recorded commands.
+typedef struct
+{
+    VkCommandPool pool;
+    VkCommandBuffer commandBuffers[AR_MAX_PARALLEL_SECTIONS];
+    uint32_t commandBufferCount;
+    uint32_t usedCount;
+}
+ArRecordingPool;
+
+typedef struct
+{
+    void (*pfnJob)(void* pData);
+    void (*pfnRange)(void* pData, uint32_t begin, uint32_t end);
+    void* pData;
+    uint32_t begin;
+    uint32_t end;
+    ArJobCounter* pCounter;
+}
+ArJob;
+
+// Chase-Lev deque: the owning thread pushes and pops at the bottom, other threads steal from the top.
+typedef struct
+{
+    int64_t volatile top;
+    char topPadding[64 - sizeof(int64_t)];
+    int64_t volatile bottom;
+    char bottomPadding[64 - sizeof(int64_t)];
+    ArJob jobs[AR_JOB_QUEUE_SIZE];
+}
+ArJobQueue;
+
 typedef struct
 {
     bool isDown     : 1;
@@ -32,6 +279,68 @@ typedef struct
 }
 ArKeyInternal;
 
+typedef struct ArMemoryPool ArMemoryPool;
+typedef struct ArMemoryBlock ArMemoryBlock;
+typedef struct ArAllocation ArAllocation;
+
+struct ArAllocation
+{
+    ArMemoryBlock* pBlock;
+    ArAllocation* pPrevPhysical;
+    ArAllocation* pNextPhysical;
+    ArAllocation* pPrevFree;
+    ArAllocation* pNextFree;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    ArMemoryCategory category;
+    bool isFree;
+};
+
+struct ArMemoryBlock
+{
+    ArMemoryPool* pPool;
+    ArMemoryBlock* pNext;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void* pMapped;
+    uint32_t allocationCount;
+    bool isDedicated;
+};
+
+// Linear and optimal resources live in separate pools, so bufferImageGranularity never applies within a block.
+struct ArMemoryPool
+{
+    ArMemoryBlock* pBlocks;
+    uint32_t memoryTypeIndex;
+    uint32_t flBitmap;
+    uint32_t slBitmap[AR_TLSF_FL_COUNT];
+    ArAllocation* pFree[AR_TLSF_FL_COUNT][AR_TLSF_SL_COUNT];
+};
+
+// Handles dropped by the application are kept until the work that may still reference them has completed.
+typedef struct
+{
+    VkBuffer buffer;
+    VkImage image;
+    VkImageView view;
+    VkPipeline pipeline;
+    ArAllocation* pAllocation;
+    uint64_t frame;
+    uint64_t upload;
+}
+ArDeferredDestroy;
+
+// Memory shared by the transient images of one slot, kept across resizes while it is large enough.
+// Memory that became too small is retired until the images still waiting for deferred destruction are gone.
+typedef struct
+{
+    ArAllocation* pAllocation;
+    uint32_t refCount;
+    ArAllocation* pRetiredAllocation;
+    uint32_t retiredRefCount;
+}
+ArTransientSlot;
+
 struct
 {
     PFN_vkDestroySurfaceKHR vkDestroySurfaceKHR;
@@ -47,19 +356,29 @@ struct
     PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
     PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
     PFN_vkEnumerateInstanceVersion vkEnumerateInstanceVersion;
+    PFN_vkEnumerateInstanceExtensionProperties vkEnumerateInstanceExtensionProperties;
     PFN_vkCreateInstance vkCreateInstance;
     PFN_vkCreateDevice vkCreateDevice;
+#if defined(AR_PLATFORM_WIN32)
     PFN_vkCreateWin32SurfaceKHR vkCreateWin32SurfaceKHR;
+#elif defined(AR_PLATFORM_XCB)
+    PFN_vkCreateXcbSurfaceKHR vkCreateXcbSurfaceKHR;
+#elif defined(AR_PLATFORM_WAYLAND)
+    PFN_vkCreateWaylandSurfaceKHR vkCreateWaylandSurfaceKHR;
+#endif
     PFN_vkEnumeratePhysicalDevices vkEnumeratePhysicalDevices;
     PFN_vkGetPhysicalDeviceSurfaceSupportKHR vkGetPhysicalDeviceSurfaceSupportKHR;
     PFN_vkEnumerateDeviceExtensionProperties vkEnumerateDeviceExtensionProperties;
     PFN_vkGetPhysicalDeviceFeatures vkGetPhysicalDeviceFeatures;
+    PFN_vkGetPhysicalDeviceFeatures2 vkGetPhysicalDeviceFeatures2;
     PFN_vkGetPhysicalDeviceFormatProperties vkGetPhysicalDeviceFormatProperties;
     PFN_vkGetPhysicalDeviceImageFormatProperties vkGetPhysicalDeviceImageFormatProperties;
     PFN_vkGetPhysicalDeviceMemoryProperties vkGetPhysicalDeviceMemoryProperties;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 vkGetPhysicalDeviceMemoryProperties2;
     PFN_vkGetPhysicalDeviceProperties vkGetPhysicalDeviceProperties;
     PFN_vkGetPhysicalDeviceQueueFamilyProperties vkGetPhysicalDeviceQueueFamilyProperties;
     PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR vkGetPhysicalDeviceSurfaceCapabilitiesKHR;
+    PFN_vkGetPhysicalDeviceSurfaceCapabilities2KHR vkGetPhysicalDeviceSurfaceCapabilities2KHR;
     PFN_vkGetPhysicalDeviceSurfaceFormatsKHR vkGetPhysicalDeviceSurfaceFormatsKHR;
     PFN_vkGetPhysicalDeviceSurfacePresentModesKHR vkGetPhysicalDeviceSurfacePresentModesKHR;
     PFN_vkAllocateDescriptorSets vkAllocateDescriptorSets;
@@ -105,6 +424,7 @@ struct
     PFN_vkCmdBindPipeline vkCmdBindPipeline;
     PFN_vkCmdCopyBuffer vkCmdCopyBuffer;
     PFN_vkCmdCopyBufferToImage vkCmdCopyBufferToImage;
+    PFN_vkCmdCopyImageToBuffer vkCmdCopyImageToBuffer;
     PFN_vkCmdDraw vkCmdDraw;
     PFN_vkCmdDrawIndexed vkCmdDrawIndexed;
     PFN_vkCmdDrawIndexedIndirect vkCmdDrawIndexedIndirect;
@@ -117,14 +437,16 @@ struct
     PFN_vkCmdDrawIndirectCount vkCmdDrawIndirectCount;
     PFN_vkCmdBeginRendering vkCmdBeginRendering;
     PFN_vkCmdEndRendering vkCmdEndRendering;
+    PFN_vkCmdExecuteCommands vkCmdExecuteCommands;
+    PFN_vkWaitForPresentKHR vkWaitForPresentKHR;
     PFN_vkCmdPipelineBarrier2 vkCmdPipelineBarrier2;
 
     PFN_vkResetCommandPool vkResetCommandPool;
     PFN_vkDeviceWaitIdle vkDeviceWaitIdle;
     PFN_vkQueueWaitIdle vkQueueWaitIdle;
     
-    PFN_vkWaitForFences vkWaitForFences;
-    PFN_vkResetFences vkResetFences;
+    PFN_vkWaitSemaphores vkWaitSemaphores;
+    PFN_vkGetSemaphoreCounterValue vkGetSemaphoreCounterValue;
     PFN_vkAcquireNextImageKHR vkAcquireNextImageKHR;
     PFN_vkQueueSubmit2 vkQueueSubmit2;
     PFN_vkQueuePresentKHR vkQueuePresentKHR;
@@ -132,21 +454,94 @@ struct
     void (*pfnUpdate)();
     void (*pfnResize)();
     void (*pfnRecordCommands)();
+#if defined(AR_PLATFORM_WIN32)
     LARGE_INTEGER timeOffset;
     LARGE_INTEGER timeFrequency;
+    HANDLE frameTimer;
+#elif defined(AR_PLATFORM_POSIX)
+    struct timespec timeOffset;
+#endif
+    double targetFrameRate;
+    bool onDemandRendering;
+    bool redrawRequested;
+    bool suspended;
+    double nextFrameTime;
     double previousTime;
     double deltaTime;
+    ArJobQueue* pJobQueues;
+    uint32_t jobThreadCount;
+    int64_t volatile jobQueued;
+    int64_t volatile jobSleepers;
+    int64_t volatile jobQuit;
+#if defined(AR_PLATFORM_WIN32)
+    HANDLE jobThreads[AR_MAX_JOB_THREADS];
+    HANDLE jobSemaphore;
+    DWORD jobThreadKey;
+#elif defined(AR_PLATFORM_POSIX)
+    pthread_t jobThreads[AR_MAX_JOB_THREADS];
+    sem_t jobSemaphore;
+    pthread_key_t jobThreadKey;
+#endif
+#if defined(AR_PLATFORM_WIN32)
     HINSTANCE hinstance;
     HWND hwnd;
+#elif defined(AR_PLATFORM_XCB)
+    xcb_connection_t* connection;
+    xcb_screen_t* screen;
+    xcb_window_t window;
+    xcb_atom_t wmProtocols;
+    xcb_atom_t wmDeleteWindow;
+    xcb_cursor_t hiddenCursor;
+    xcb_generic_event_t* pendingEvent;
+    uint8_t xinputOpcode;
+    uint8_t keycodes[256];
+    int pointerX;
+    int pointerY;
+    int pointerRootX;
+    int pointerRootY;
+#elif defined(AR_PLATFORM_WAYLAND)
+    struct wl_display* display;
+    struct wl_registry* registry;
+    struct wl_compositor* compositor;
+    struct wl_shm* shm;
+    struct wl_seat* seat;
+    struct wl_pointer* pointer;
+    struct wl_keyboard* keyboard;
+    struct xdg_wm_base* wmBase;
+    struct wl_surface* wlSurface;
+    struct xdg_surface* xdgSurface;
+    struct xdg_toplevel* toplevel;
+    struct wl_surface* frameSurface;
+    struct wl_event_queue* frameQueue;
+    struct wl_callback* frameCallback;
+    struct wl_cursor_theme* cursorTheme;
+    struct wl_cursor* cursor;
+    struct wl_surface* cursorSurface;
+    uint32_t pointerSerial;
+    int pendingWidth;
+    int pendingHeight;
+    int pointerX;
+    int pointerY;
+    bool configured;
+    bool cursorHidden;
+#endif
     VkInstance instance;
     VkPhysicalDevice gpu;
     VkSurfaceKHR surface;
     uint32_t graphicsQueueFamily;
     uint32_t presentQueueFamily;
+    uint32_t transferQueueFamily;
     VkCommandPool graphicsCommandPool;
     VkCommandPool presentCommandPool;
-    VkCommandPool transferCommandPool;
-    VkCommandBuffer transferCommandBuffer;
+    ArRetiredSwapchain retiredSwapchains[AR_MAX_RETIRED_SWAPCHAINS];
+    uint32_t retiredSwapchainCount;
+    uint64_t swapchainFrame;
+    ArDeferredDestroy* pDeferred;
+    uint32_t deferredCount;
+    uint32_t deferredCapacity;
+    ArTransientSlot transientSlots[AR_MAX_TRANSIENT_SLOTS];
+    ArTransfer transfers[AR_TRANSFER_SLOT_COUNT];
+    ArTransfer* pTransfer;
     VkPipelineLayout pipelineLayout;
     VkDescriptorPool descriptorPool;
     VkDescriptorSetLayout descriptorSetLayout;
@@ -156,17 +551,55 @@ struct
     VkSampler samplerNearestToEdge;
     VkSampler samplerNearestRepeat;
     ArFrame* pFrame;
+    ArCommandStream commandStream;
+    size_t renderingOffset;
+    ArRecordingPool recordingPools[AR_MAX_FRAMES_IN_FLIGHT + 1][AR_MAX_RECORDING_THREADS];
+    uint32_t recordingSet;
+    VkCommandBuffer parallelCmds[AR_MAX_RECORDING_THREADS];
+    uint32_t parallelCmdCount;
     uint32_t imageIndex;
     uint32_t imageCount;
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue;
     VkSwapchainKHR swapchain;
-    VkFence fence;
+    VkSemaphore timeline;
+    VkSemaphore acqSemaphores[AR_MAX_FRAMES_IN_FLIGHT];
+    uint32_t framesInFlight;
+    uint32_t frameIndex;
+    VkCommandPool framePools[AR_MAX_FRAMES_IN_FLIGHT];
+    VkCommandBuffer frameCommandBuffers[AR_MAX_FRAMES_IN_FLIGHT];
+    ArMemoryPool memoryPools[VK_MAX_MEMORY_TYPES][2];
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    uint32_t memoryTypeOrder[AR_MEMORY_USAGE_COUNT][VK_MAX_MEMORY_TYPES];
+    uint32_t memoryTypeOrderCount[AR_MEMORY_USAGE_COUNT];
+    bool unifiedMemory;
+    bool resizableBar;
+    bool memoryBudget;
+    VkDeviceSize heapBlockBytes[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heapAllocationBytes[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize categoryBytes[AR_MEMORY_CATEGORY_COUNT];
+    uint32_t blockCount;
+    uint32_t dedicatedBlockCount;
+    uint32_t allocationCount;
+    ArBuffer transientBuffer;
+    uint64_t transientSize;
+    uint64_t transientOffset;
+    VkSemaphore uploadTimeline;
+    VkSemaphore acquireTimeline;
+    uint64_t uploadCounter;
+    uint64_t acquireCounter;
+    uint64_t transferWaitFrame;
+    bool uploadBatch;
+    uint64_t uploadReclaimed;
+    ArBuffer stagingBuffer;
+    VkDeviceSize stagingHead;
+    VkDeviceSize stagingTail;
     VkCommandBufferSubmitInfo graphicsCommandBufferInfo;
     VkCommandBufferSubmitInfo presentCommandBufferInfo;
     VkSemaphoreSubmitInfo acqSemaphore;
-    VkSemaphoreSubmitInfo renSemaphore;
+    VkSemaphoreSubmitInfo signalSemaphores[2]; // render semaphore, frame timeline
     VkSemaphoreSubmitInfo preSemaphore;
     VkSubmitInfo2 submitInfo;
     VkSubmitInfo2 presentSubmitInfo;
@@ -175,8 +608,34 @@ struct
     VkExtent2D extent;
     int width, height;
     bool unifiedQueue;
+    bool dedicatedTransfer;
     bool vsyncEnabled;
+    bool swapchainDirty;
+    bool surfaceMaintenance1;
+    bool swapchainMaintenance1;
+    bool presentWait;
+    bool lowLatency;
+    uint64_t presentIdValue;
+    VkSwapchainKHR presentIdSwapchain;
+    VkPresentIdKHR presentIdInfo;
+    double inputTimes[AR_MAX_FRAMES_IN_FLIGHT];
+    double frameLatency;
+    ArPresentMode presentModeRequest;
+    uint32_t swapchainImageCount;
+    VkPresentModeKHR presentMode;
+    VkPresentModeKHR compatiblePresentModes[8];
+    uint32_t compatiblePresentModeCount;
+    VkSwapchainPresentModeInfoEXT presentModeInfo;
     bool windowShouldClose;
+    bool headless;
+    bool immediateRecording;
+    double headlessTimeStep;
+    uint64_t frameCounter;
+    uint64_t skippedFrameCount;
+    uint64_t suboptimalFrameCount;
+    uint64_t swapchainRecreateCount;
+    ArImage headlessImages[AR_HEADLESS_IMAGE_COUNT];
+    ArBuffer headlessReadback;
     int globalCursorX;
     int globalCursorY;
     int cursorX;
@@ -187,34 +646,70 @@ struct
     int cursorRelY;
     ArKeyInternal keys[255];
     ArKeyInternal buttons[5];
+#if defined(AR_PLATFORM_WIN32)
     BYTE lpb[sizeof(RAWINPUT)];
+#endif
 }
 global g;
 
-internal uint32_t arFindMemoryType(uint32_t typeBitsRequirement, VkMemoryPropertyFlags properties);
+internal void arMemoryTypesCreate(void);
+internal uint32_t arFindMemoryType(uint32_t typeBitsRequirement, ArMemoryUsage usage);
 internal void* arLoadInstanceFunction(char const* name);
 internal void* arLoadDeviceFunction(char const* name);
 internal void arError(char const* message);
 internal void arLoadInstanceFunctions(void);
 internal void arLoadDeviceFunctions(void);
-internal void arAllocBuffer(ArBuffer* pBuffer, bool isDynamic);
+internal void arAllocBuffer(ArBuffer* pBuffer, ArMemoryCategory category, ArMemoryUsage usage);
+internal void arCreateMappedBuffer(ArBuffer* pBuffer, uint64_t capacity, ArMemoryCategory category, ArMemoryUsage usage);
 internal void arWindowCreate(int width, int height);
 internal void arWindowTeardown(void);
 internal void arSwapchainCreate(bool vsync);
 internal void arSwapchainTeardown(void);
 internal void arSwapchainRecreate(bool vsync);
+internal void arSwapchainCollect(uint64_t completed);
+internal void arHeadlessCreate(void);
+internal void arHeadlessTeardown(void);
+internal void arTimerCreate(void);
+internal void arTimerTeardown(void);
+internal void arPaceFrame(void);
 internal void arContextCreate(void);
 internal void arContextTeardown(void);
 internal void arRecordCommands(void);
-internal void arBeginTransfer();
-internal void arEndTransfer();
+internal void* arCommandPush(ArCommandStream* pStream, ArCommandType type, size_t size);
+internal void arCommandReplay(ArCommandStream const* pStream, VkCommandBuffer cmd);
+internal void arRecordFrame(void);
+internal void arJobsCreate(uint32_t threadCount);
+internal void arWaitLatency(void);
+internal void arJobsTeardown(void);
+internal void arResetRecordingPools(uint32_t set, VkCommandPoolResetFlags flags);
+internal void arMemoryTeardown(void);
+internal void arDeferDestroy(ArDeferredDestroy* pEntry);
+internal void arDeferredCollect(uint64_t completedFrame, uint64_t completedUpload);
+internal void arImageCreate(ArImage* pImage, ArImageCreateInfo const* pImageCreateInfo, uint32_t aliasSlot, VkImageUsageFlags extraUsage);
+internal void arFreeMemory(ArAllocation* pNode);
+internal void arReleaseImageMemory(ArAllocation* pAllocation);
+internal void* arHostAlloc(size_t size);
+internal void arHostFree(void* pMemory);
+internal void arBeginTransfer(void);
+internal void arEndTransfer(void);
+internal void arWaitTimeline(VkSemaphore semaphore, uint64_t value);
+internal void arFlushAcquires(uint64_t value);
+internal void arStagingReclaim(void);
+internal uint64_t arEndUpload(void);
+internal void arReleaseToGraphics(VkBufferMemoryBarrier2* pBufferBarrier, VkImageMemoryBarrier2* pImageBarrier);
+internal VkDeviceSize arStagingAlloc(VkDeviceSize size);
 
 internal void
 arError(
     char const* message)
 {
+#if defined(AR_PLATFORM_WIN32)
     MessageBoxA(NULL, message, NULL, MB_ICONERROR);
     ExitProcess(1);
+#elif defined(AR_PLATFORM_POSIX)
+    fprintf(stderr, "arline: %s\n", message);
+    exit(1);
+#endif
 }
 
 internal void
@@ -267,14 +762,23 @@ arLoadInstanceFunctions(void)
     g.vkEnumeratePhysicalDevices = (PFN_vkEnumeratePhysicalDevices)arLoadInstanceFunction("vkEnumeratePhysicalDevices");
     g.vkGetDeviceProcAddr = (PFN_vkGetDeviceProcAddr)arLoadInstanceFunction("vkGetDeviceProcAddr");
     g.vkGetPhysicalDeviceFeatures = (PFN_vkGetPhysicalDeviceFeatures)arLoadInstanceFunction("vkGetPhysicalDeviceFeatures");
+    g.vkGetPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)arLoadInstanceFunction("vkGetPhysicalDeviceFeatures2");
     g.vkGetPhysicalDeviceFormatProperties = (PFN_vkGetPhysicalDeviceFormatProperties)arLoadInstanceFunction("vkGetPhysicalDeviceFormatProperties");
     g.vkGetPhysicalDeviceImageFormatProperties = (PFN_vkGetPhysicalDeviceImageFormatProperties)arLoadInstanceFunction("vkGetPhysicalDeviceImageFormatProperties");
     g.vkGetPhysicalDeviceMemoryProperties = (PFN_vkGetPhysicalDeviceMemoryProperties)arLoadInstanceFunction("vkGetPhysicalDeviceMemoryProperties");
+    g.vkGetPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2)arLoadInstanceFunction("vkGetPhysicalDeviceMemoryProperties2");
     g.vkGetPhysicalDeviceProperties = (PFN_vkGetPhysicalDeviceProperties)arLoadInstanceFunction("vkGetPhysicalDeviceProperties");
     g.vkGetPhysicalDeviceQueueFamilyProperties = (PFN_vkGetPhysicalDeviceQueueFamilyProperties)arLoadInstanceFunction("vkGetPhysicalDeviceQueueFamilyProperties");
+#if defined(AR_PLATFORM_WIN32)
     g.vkCreateWin32SurfaceKHR = (PFN_vkCreateWin32SurfaceKHR)arLoadInstanceFunction("vkCreateWin32SurfaceKHR");
+#elif defined(AR_PLATFORM_XCB)
+    g.vkCreateXcbSurfaceKHR = (PFN_vkCreateXcbSurfaceKHR)arLoadInstanceFunction("vkCreateXcbSurfaceKHR");
+#elif defined(AR_PLATFORM_WAYLAND)
+    g.vkCreateWaylandSurfaceKHR = (PFN_vkCreateWaylandSurfaceKHR)arLoadInstanceFunction("vkCreateWaylandSurfaceKHR");
+#endif
     g.vkDestroySurfaceKHR = (PFN_vkDestroySurfaceKHR)arLoadInstanceFunction("vkDestroySurfaceKHR");
     g.vkGetPhysicalDeviceSurfaceCapabilitiesKHR = (PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR)arLoadInstanceFunction("vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+    g.vkGetPhysicalDeviceSurfaceCapabilities2KHR = (PFN_vkGetPhysicalDeviceSurfaceCapabilities2KHR)arLoadInstanceFunction("vkGetPhysicalDeviceSurfaceCapabilities2KHR");
     g.vkGetPhysicalDeviceSurfaceFormatsKHR = (PFN_vkGetPhysicalDeviceSurfaceFormatsKHR)arLoadInstanceFunction("vkGetPhysicalDeviceSurfaceFormatsKHR");
     g.vkGetPhysicalDeviceSurfacePresentModesKHR = (PFN_vkGetPhysicalDeviceSurfacePresentModesKHR)arLoadInstanceFunction("vkGetPhysicalDeviceSurfacePresentModesKHR");
     g.vkGetPhysicalDeviceSurfaceSupportKHR = (PFN_vkGetPhysicalDeviceSurfaceSupportKHR)arLoadInstanceFunction("vkGetPhysicalDeviceSurfaceSupportKHR");
@@ -294,6 +798,7 @@ arLoadDeviceFunctions()
     g.vkCmdBindPipeline = (PFN_vkCmdBindPipeline)arLoadDeviceFunction("vkCmdBindPipeline");
     g.vkCmdCopyBuffer = (PFN_vkCmdCopyBuffer)arLoadDeviceFunction("vkCmdCopyBuffer");
     g.vkCmdCopyBufferToImage = (PFN_vkCmdCopyBufferToImage)arLoadDeviceFunction("vkCmdCopyBufferToImage");
+    g.vkCmdCopyImageToBuffer = (PFN_vkCmdCopyImageToBuffer)arLoadDeviceFunction("vkCmdCopyImageToBuffer");
     g.vkCmdDraw = (PFN_vkCmdDraw)arLoadDeviceFunction("vkCmdDraw");
     g.vkCmdDrawIndexed = (PFN_vkCmdDrawIndexed)arLoadDeviceFunction("vkCmdDrawIndexed");
     g.vkCmdDrawIndexedIndirect = (PFN_vkCmdDrawIndexedIndirect)arLoadDeviceFunction("vkCmdDrawIndexedIndirect");
@@ -335,15 +840,17 @@ arLoadDeviceFunctions()
     g.vkMapMemory = (PFN_vkMapMemory)arLoadDeviceFunction("vkMapMemory");
     g.vkQueueWaitIdle = (PFN_vkQueueWaitIdle)arLoadDeviceFunction("vkQueueWaitIdle");
     g.vkResetCommandPool = (PFN_vkResetCommandPool)arLoadDeviceFunction("vkResetCommandPool");
-    g.vkResetFences = (PFN_vkResetFences)arLoadDeviceFunction("vkResetFences");
     g.vkUnmapMemory = (PFN_vkUnmapMemory)arLoadDeviceFunction("vkUnmapMemory");
     g.vkUpdateDescriptorSets = (PFN_vkUpdateDescriptorSets)arLoadDeviceFunction("vkUpdateDescriptorSets");
-    g.vkWaitForFences = (PFN_vkWaitForFences)arLoadDeviceFunction("vkWaitForFences");
+    g.vkWaitSemaphores = (PFN_vkWaitSemaphores)arLoadDeviceFunction("vkWaitSemaphores");
+    g.vkGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)arLoadDeviceFunction("vkGetSemaphoreCounterValue");
     g.vkCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCount)arLoadDeviceFunction("vkCmdDrawIndexedIndirectCount");
     g.vkCmdDrawIndirectCount = (PFN_vkCmdDrawIndirectCount)arLoadDeviceFunction("vkCmdDrawIndirectCount");
     g.vkGetBufferDeviceAddress = (PFN_vkGetBufferDeviceAddress)arLoadDeviceFunction("vkGetBufferDeviceAddress");
     g.vkCmdBeginRendering = (PFN_vkCmdBeginRendering)arLoadDeviceFunction("vkCmdBeginRendering");
     g.vkCmdEndRendering = (PFN_vkCmdEndRendering)arLoadDeviceFunction("vkCmdEndRendering");
+    g.vkCmdExecuteCommands = (PFN_vkCmdExecuteCommands)arLoadDeviceFunction("vkCmdExecuteCommands");
+    g.vkWaitForPresentKHR = (PFN_vkWaitForPresentKHR)arLoadDeviceFunction("vkWaitForPresentKHR");
     g.vkCmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2)arLoadDeviceFunction("vkCmdPipelineBarrier2");
     g.vkQueueSubmit2 = (PFN_vkQueueSubmit2)arLoadDeviceFunction("vkQueueSubmit2");
     g.vkAcquireNextImageKHR = (PFN_vkAcquireNextImageKHR)arLoadDeviceFunction("vkAcquireNextImageKHR");
@@ -353,6 +860,7 @@ arLoadDeviceFunctions()
     g.vkQueuePresentKHR = (PFN_vkQueuePresentKHR)arLoadDeviceFunction("vkQueuePresentKHR");
 }
 
+#if defined(AR_PLATFORM_WIN32)
 internal LRESULT
 arWndProc(
     HWND hwnd,
@@ -419,24 +927,19 @@ arWndProc(
         } 
     } break;
     case WM_SIZE:
-        g.width = LOWORD(lp);
-        g.height = HIWORD(lp);
+        // A minimized window keeps its last size, the main loop sleeps until it is restored.
+        g.suspended = wp == SIZE_MINIMIZED || !LOWORD(lp) || !HIWORD(lp);
 
-        while (!g.width || !g.height)
+        if (g.suspended)
         {
-            g.pfnUpdate();
-
-            if (g.windowShouldClose)
-            {
-                return(0);
-            }
+            break;
         }
 
-        if (g.device)
-        {
-            g.vkDeviceWaitIdle(g.device);
-            arSwapchainRecreate(g.vsyncEnabled);
-        }
+        g.width = LOWORD(lp);
+        g.height = HIWORD(lp);
+
+        // Resizes are coalesced and handled once per frame.
+        g.swapchainDirty = g.device != NULL;
         break;
     case WM_GETMINMAXINFO:
         ((PMINMAXINFO)lp)->ptMinTrackSize.x = 150;
@@ -467,8 +970,6 @@ arWindowCreate(
     int width,
     int height)
 {
-    QueryPerformanceFrequency(&g.timeFrequency);
-    QueryPerformanceCounter(&g.timeOffset);
     g.hinstance = GetModuleHandleA(NULL);
 
     WNDCLASSEXA wc;
@@ -528,372 +1029,1804 @@ arWindowTeardown(void)
     DestroyWindow(g.hwnd);
     UnregisterClassA("arline", g.hinstance);
 }
+#elif defined(AR_PLATFORM_XCB)
+internal uint8_t
+arTranslateKeysym(
+    uint32_t keysym)
+{
+    if (keysym >= 'a' && keysym <= 'z')
+    {
+        return((uint8_t)(keysym - 'a' + AR_KEY_A));
+    }
+
+    if (keysym >= '0' && keysym <= '9')
+    {
+        return((uint8_t)(keysym - '0' + AR_KEY_0));
+    }
+
+    if (keysym >= 0xffbe && keysym <= 0xffd5)
+    {
+        return((uint8_t)(keysym - 0xffbe + AR_KEY_F1));
+    }
+
+    switch (keysym)
+    {
+    case 0x0020: return(AR_KEY_SPACE);
+    case 0x0027: return(AR_KEY_APOSTROPHE);
+    case 0x002c: return(AR_KEY_COMMA);
+    case 0x002d: return(AR_KEY_MINUS);
+    case 0x002e: return(AR_KEY_PERIOD);
+    case 0x002f: return(AR_KEY_SLASH);
+    case 0x003b: return(AR_KEY_SEMICOLON);
+    case 0x003d: return(AR_KEY_PLUS);
+    case 0x005b: return(AR_KEY_LBRACKET);
+    case 0x005c: return(AR_KEY_BACKSLASH);
+    case 0x005d: return(AR_KEY_RBRACKET);
+    case 0x0060: return(AR_KEY_GRAVE);
+    case 0xff08: return(AR_KEY_BACKSPACE);
+    case 0xff09: return(AR_KEY_TAB);
+    case 0xff0d: return(AR_KEY_ENTER);
+    case 0xff13: return(AR_KEY_PAUSE);
+    case 0xff14: return(AR_KEY_SCROLL_LOCK);
+    case 0xff1b: return(AR_KEY_ESCAPE);
+    case 0xff50: return(AR_KEY_HOME);
+    case 0xff51: return(AR_KEY_LEFT);
+    case 0xff52: return(AR_KEY_UP);
+    case 0xff53: return(AR_KEY_RIGHT);
+    case 0xff54: return(AR_KEY_DOWN);
+    case 0xff55: return(AR_KEY_PAGE_UP);
+    case 0xff56: return(AR_KEY_PAGE_DOWN);
+    case 0xff57: return(AR_KEY_END);
+    case 0xff61: return(AR_KEY_PRINT_SCREEN);
+    case 0xff63: return(AR_KEY_INSERT);
+    case 0xff67: return(AR_KEY_MENU);
+    case 0xffe1:
+    case 0xffe2: return(AR_KEY_SHIFT);
+    case 0xffe3:
+    case 0xffe4: return(AR_KEY_CTRL);
+    case 0xffe5: return(AR_KEY_CAPS_LOCK);
+    case 0xffe9:
+    case 0xffea: return(AR_KEY_ALT);
+    case 0xffff: return(AR_KEY_DELETE);
+    default:     return(0);
+    }
+}
 
 internal void
-arSwapchainCreate(
-    bool vsync)
+arXcbHandleEvent(
+    xcb_generic_event_t* event)
 {
-    g.vsyncEnabled = vsync;
+    switch (event->response_type & 0x7f)
+    {
+    case XCB_KEY_PRESS:
+    {
+        xcb_key_press_event_t* key = (xcb_key_press_event_t*)event;
+        ArKeyInternal* state = &g.keys[g.keycodes[key->detail]];
+        state->isPressed = !state->isDown;
+        state->isDown = true;
+    } break;
+    case XCB_KEY_RELEASE:
+    {
+        xcb_key_release_event_t* key = (xcb_key_release_event_t*)event;
+        xcb_generic_event_t* next = xcb_poll_for_queued_event(g.connection);
 
-    VkSurfaceCapabilitiesKHR surfaceCapabilities;
-    arVkCheck(g.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(g.gpu, g.surface, &surfaceCapabilities));
+        if (next &&
+            (next->response_type & 0x7f) == XCB_KEY_PRESS &&
+            ((xcb_key_press_event_t*)next)->detail == key->detail &&
+            ((xcb_key_press_event_t*)next)->time == key->time)
+        {
+            free(next);
+            break;
+        }
 
-    g.extent.width  = surfaceCapabilities.currentExtent.width;
-    g.extent.height = surfaceCapabilities.currentExtent.height;
+        g.keys[g.keycodes[key->detail]].isDown = false;
+        g.keys[g.keycodes[key->detail]].isReleased = true;
 
-    if (g.extent.width == 0xffffffff)
+        if (next)
+        {
+            arXcbHandleEvent(next);
+            free(next);
+        }
+    } break;
+    case XCB_BUTTON_PRESS:
+    case XCB_BUTTON_RELEASE:
     {
-        g.extent.width  = surfaceCapabilities.minImageExtent.width;
-        g.extent.height = surfaceCapabilities.minImageExtent.height;
-    }
+        xcb_button_press_event_t* button = (xcb_button_press_event_t*)event;
+        ArButton index;
 
-    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        switch (button->detail)
+        {
+        case 1: index = AR_BUTTON_LEFT; break;
+        case 2: index = AR_BUTTON_MIDDLE; break;
+        case 3: index = AR_BUTTON_RIGHT; break;
+        case 8: index = AR_BUTTON_BACKWARD; break;
+        case 9: index = AR_BUTTON_FORWARD; break;
+        default: return;
+        }
 
-    if (!vsync)
+        if ((event->response_type & 0x7f) == XCB_BUTTON_PRESS)
+        {
+            g.buttons[index].isDown    = true;
+            g.buttons[index].isPressed = true;
+        }
+        else
+        {
+            g.buttons[index].isDown     = false;
+            g.buttons[index].isReleased = true;
+        }
+    } break;
+    case XCB_MOTION_NOTIFY:
+    {
+        xcb_motion_notify_event_t* motion = (xcb_motion_notify_event_t*)event;
+        g.pointerX = motion->event_x;
+        g.pointerY = motion->event_y;
+        g.pointerRootX = motion->root_x;
+        g.pointerRootY = motion->root_y;
+    } break;
+    case XCB_GE_GENERIC:
     {
-        VkPresentModeKHR presentModes[6];
-        uint32_t presentModeCount;
-        arVkCheck(g.vkGetPhysicalDeviceSurfacePresentModesKHR(g.gpu, g.surface, &presentModeCount, NULL));
-        presentModeCount = min(presentModeCount, 6);
-        arVkCheck(g.vkGetPhysicalDeviceSurfacePresentModesKHR(g.gpu, g.surface, &presentModeCount, presentModes));
+        xcb_ge_generic_event_t* generic = (xcb_ge_generic_event_t*)event;
+
+        if (generic->extension != g.xinputOpcode ||
+            generic->event_type != XCB_INPUT_RAW_MOTION)
+        {
+            break;
+        }
+
+        xcb_input_raw_motion_event_t* raw = (xcb_input_raw_motion_event_t*)event;
+
+        if (!raw->valuators_len)
+        {
+            break;
+        }
 
-        for ( ; presentModeCount--; )
+        uint32_t const* mask = xcb_input_raw_motion_valuator_mask(raw);
+        xcb_input_fp3232_t const* values = xcb_input_raw_motion_axisvalues_raw(raw);
+        uint32_t valueIndex = 0;
+
+        for (uint32_t axis = 0; axis < 2; ++axis)
         {
-            if (presentModes[presentModeCount] == VK_PRESENT_MODE_MAILBOX_KHR)
+            if (!(mask[0] & (1u << axis)))
             {
-                presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
-                break;
+                continue;
             }
 
-            if (presentModes[presentModeCount] == VK_PRESENT_MODE_IMMEDIATE_KHR)
+            int value = values[valueIndex].integral;
+            valueIndex += 1;
+
+            if (axis == 0)
+            {
+                g.cursorRelX += value;
+            }
+            else
             {
-                presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+                g.cursorRelY += value;
             }
         }
+    } break;
+    case XCB_CONFIGURE_NOTIFY:
+    {
+        xcb_configure_notify_event_t* configure = (xcb_configure_notify_event_t*)event;
+
+        if (configure->width == g.width && configure->height == g.height)
+        {
+            break;
+        }
+
+        g.width = configure->width;
+        g.height = configure->height;
+        g.swapchainDirty = g.device != NULL;
+    } break;
+    case XCB_UNMAP_NOTIFY:
+        g.suspended = true;
+        break;
+    case XCB_MAP_NOTIFY:
+        g.suspended = false;
+        g.redrawRequested = true;
+        break;
+    case XCB_CLIENT_MESSAGE:
+        if (((xcb_client_message_event_t*)event)->data.data32[0] == g.wmDeleteWindow)
+        {
+            g.windowShouldClose = true;
+        }
+        break;
+    case XCB_FOCUS_OUT:
+        memset(g.keys, 0, sizeof(g.keys));
+        memset(g.buttons, 0, sizeof(g.buttons));
+        break;
     }
+}
 
-    VkSwapchainCreateInfoKHR swapchainCreateInfo;
-    swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    swapchainCreateInfo.pNext = NULL;
-    swapchainCreateInfo.flags = 0;
-    swapchainCreateInfo.surface = g.surface;
-    swapchainCreateInfo.minImageCount = surfaceCapabilities.minImageCount > 3 ? surfaceCapabilities.minImageCount : 3;
-    swapchainCreateInfo.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
-    swapchainCreateInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-    swapchainCreateInfo.imageExtent = g.extent;
-    swapchainCreateInfo.imageArrayLayers = 1;
-    swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    swapchainCreateInfo.queueFamilyIndexCount = 0;
-    swapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-    swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swapchainCreateInfo.presentMode = presentMode;
-    swapchainCreateInfo.clipped = true;
-    swapchainCreateInfo.oldSwapchain = NULL;
-    arVkCheck(g.vkCreateSwapchainKHR(g.device, &swapchainCreateInfo, NULL, &g.swapchain));
+internal xcb_atom_t
+arXcbInternAtom(
+    char const* name,
+    bool onlyIfExists)
+{
+    xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(
+        g.connection,
+        xcb_intern_atom(g.connection, onlyIfExists, (uint16_t)strlen(name), name),
+        NULL);
 
-    VkCommandBuffer commandBuffers[6];
-    VkCommandBuffer presentCommandBuffers[6];
-    VkImage swapchainImages[6];
-    arVkCheck(g.vkGetSwapchainImagesKHR(g.device, g.swapchain, &g.imageCount, NULL));
-    g.imageCount = min(g.imageCount, 6);
-    arVkCheck(g.vkGetSwapchainImagesKHR(g.device, g.swapchain, &g.imageCount, swapchainImages));
+    if (!reply)
+    {
+        arError("Failed to intern atom");
+    }
 
-    VkCommandPoolCreateInfo commandPoolCreateInfo;
-    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolCreateInfo.pNext = NULL;
-    commandPoolCreateInfo.flags = 0;
-    commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
-    arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.graphicsCommandPool));
+    xcb_atom_t atom = reply->atom;
+    free(reply);
 
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.pNext = NULL;
-    commandBufferAllocateInfo.commandPool = g.graphicsCommandPool;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = g.imageCount;
-    arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, commandBuffers));
+    return(atom);
+}
 
-    if (!g.unifiedQueue)
+internal void
+arWindowCreate(
+    int width,
+    int height)
+{
+    int screenIndex;
+    g.connection = xcb_connect(NULL, &screenIndex);
+
+    if (xcb_connection_has_error(g.connection))
     {
-        commandPoolCreateInfo.queueFamilyIndex = g.presentQueueFamily;
-        arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.presentCommandPool));
-        
-        commandBufferAllocateInfo.commandPool = g.presentCommandPool;
-        arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, presentCommandBuffers));
+        arError("Failed to connect to X server");
     }
 
-    for (uint32_t i = g.imageCount; i--; )
+    xcb_setup_t const* setup = xcb_get_setup(g.connection);
+    xcb_screen_iterator_t screens = xcb_setup_roots_iterator(setup);
+
+    for ( ; screenIndex > 0; --screenIndex)
     {
-        g.frames[i].cmd = commandBuffers[i];
-        g.frames[i].presentCmd = presentCommandBuffers[i];
-        g.frames[i].image = swapchainImages[i];
+        xcb_screen_next(&screens);
+    }
 
-        VkImageViewCreateInfo imageViewCreateInfo;
-        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        imageViewCreateInfo.pNext = NULL;
-        imageViewCreateInfo.flags = 0;
-        imageViewCreateInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
-        imageViewCreateInfo.image = swapchainImages[i];
-        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        imageViewCreateInfo.subresourceRange.levelCount = 1;
-        imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        imageViewCreateInfo.subresourceRange.layerCount = 1;
-        arVkCheck(g.vkCreateImageView(g.device, &imageViewCreateInfo, NULL, &g.frames[i].view));
+    g.screen = screens.data;
+    g.width  = width;
+    g.height = height;
+
+    uint32_t eventMask =
+        XCB_EVENT_MASK_KEY_PRESS |
+        XCB_EVENT_MASK_KEY_RELEASE |
+        XCB_EVENT_MASK_BUTTON_PRESS |
+        XCB_EVENT_MASK_BUTTON_RELEASE |
+        XCB_EVENT_MASK_POINTER_MOTION |
+        XCB_EVENT_MASK_STRUCTURE_NOTIFY |
+        XCB_EVENT_MASK_FOCUS_CHANGE;
+
+    g.window = xcb_generate_id(g.connection);
+    xcb_create_window(
+        g.connection,
+        XCB_COPY_FROM_PARENT,
+        g.window,
+        g.screen->root,
+        0,
+        0,
+        (uint16_t)width,
+        (uint16_t)height,
+        0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,
+        g.screen->root_visual,
+        XCB_CW_EVENT_MASK,
+        &eventMask);
+
+    g.wmProtocols = arXcbInternAtom("WM_PROTOCOLS", true);
+    g.wmDeleteWindow = arXcbInternAtom("WM_DELETE_WINDOW", false);
+    xcb_change_property(
+        g.connection,
+        XCB_PROP_MODE_REPLACE,
+        g.window,
+        g.wmProtocols,
+        XCB_ATOM_ATOM,
+        32,
+        1,
+        &g.wmDeleteWindow);
+
+    uint32_t sizeHints[18] = { 0 };
+    sizeHints[0] = 1 << 4;
+    sizeHints[5] = 150;
+    sizeHints[6] = 150;
+    xcb_change_property(
+        g.connection,
+        XCB_PROP_MODE_REPLACE,
+        g.window,
+        XCB_ATOM_WM_NORMAL_HINTS,
+        XCB_ATOM_WM_SIZE_HINTS,
+        32,
+        18,
+        sizeHints);
+
+    xcb_get_keyboard_mapping_reply_t* mapping = xcb_get_keyboard_mapping_reply(
+        g.connection,
+        xcb_get_keyboard_mapping(g.connection, setup->min_keycode, setup->max_keycode - setup->min_keycode + 1),
+        NULL);
 
-        if (!g.unifiedQueue)
+    if (mapping)
+    {
+        xcb_keysym_t const* keysyms = xcb_get_keyboard_mapping_keysyms(mapping);
+
+        for (uint32_t keycode = setup->min_keycode; keycode <= setup->max_keycode; ++keycode)
         {
-            VkCommandBufferBeginInfo commandBufferBeginInfo;
-            commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            commandBufferBeginInfo.pNext = NULL;
-            commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-            commandBufferBeginInfo.pInheritanceInfo = NULL;
+            g.keycodes[keycode] = arTranslateKeysym(keysyms[(keycode - setup->min_keycode) * mapping->keysyms_per_keycode]);
+        }
 
-            VkImageMemoryBarrier2 imageMemoryBarrier;
-            imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-            imageMemoryBarrier.pNext = NULL;
-            imageMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-            imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_NONE;
-            imageMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
-            imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_NONE;
-            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-            imageMemoryBarrier.srcQueueFamilyIndex = g.graphicsQueueFamily;
-            imageMemoryBarrier.dstQueueFamilyIndex = g.presentQueueFamily;
-            imageMemoryBarrier.image = swapchainImages[i];
-            imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-            imageMemoryBarrier.subresourceRange.levelCount = 1;
-            imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-            imageMemoryBarrier.subresourceRange.layerCount = 1;
+        free(mapping);
+    }
 
-            VkDependencyInfo dependencyInfo;
-            dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-            dependencyInfo.pNext = NULL;
-            dependencyInfo.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-            dependencyInfo.memoryBarrierCount = 0;
-            dependencyInfo.bufferMemoryBarrierCount = 0;
-            dependencyInfo.imageMemoryBarrierCount = 1;
-            dependencyInfo.pImageMemoryBarriers = &imageMemoryBarrier;
+    xcb_query_extension_reply_t const* xinput = xcb_get_extension_data(g.connection, &xcb_input_id);
 
-            arVkCheck(g.vkBeginCommandBuffer(presentCommandBuffers[i], &commandBufferBeginInfo));
-            g.vkCmdPipelineBarrier2(presentCommandBuffers[i], &dependencyInfo);
-            arVkCheck(g.vkEndCommandBuffer(presentCommandBuffers[i]));
+    if (xinput && xinput->present)
+    {
+        xcb_input_xi_query_version_reply_t* version = xcb_input_xi_query_version_reply(
+            g.connection,
+            xcb_input_xi_query_version(g.connection, 2, 0),
+            NULL);
+
+        if (version && version->major_version >= 2)
+        {
+            struct
+            {
+                xcb_input_event_mask_t head;
+                uint32_t mask;
+            }
+            rawMotionMask;
+            rawMotionMask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
+            rawMotionMask.head.mask_len = 1;
+            rawMotionMask.mask = XCB_INPUT_XI_EVENT_MASK_RAW_MOTION;
+
+            g.xinputOpcode = xinput->major_opcode;
+            xcb_input_xi_select_events(g.connection, g.screen->root, 1, &rawMotionMask.head);
         }
+
+        free(version);
     }
 
-    g.submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-    g.submitInfo.pNext = NULL;
-    g.submitInfo.flags = 0;
-    g.submitInfo.waitSemaphoreInfoCount = 1;
-    g.submitInfo.pWaitSemaphoreInfos = &g.acqSemaphore;
-    g.submitInfo.commandBufferInfoCount = 1;
-    g.submitInfo.pCommandBufferInfos = &g.graphicsCommandBufferInfo;
-    g.submitInfo.signalSemaphoreInfoCount = 1;
-    g.submitInfo.pSignalSemaphoreInfos = &g.renSemaphore;
+    xcb_pixmap_t pixmap = xcb_generate_id(g.connection);
+    xcb_create_pixmap(g.connection, 1, pixmap, g.screen->root, 1, 1);
+    g.hiddenCursor = xcb_generate_id(g.connection);
+    xcb_create_cursor(g.connection, g.hiddenCursor, pixmap, pixmap, 0, 0, 0, 0, 0, 0, 0, 0);
+    xcb_free_pixmap(g.connection, pixmap);
 
-    g.presentSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-    g.presentSubmitInfo.pNext = NULL;
-    g.presentSubmitInfo.flags = 0;
-    g.presentSubmitInfo.waitSemaphoreInfoCount = 1;
-    g.presentSubmitInfo.pWaitSemaphoreInfos = &g.renSemaphore;
-    g.presentSubmitInfo.commandBufferInfoCount = 1;
-    g.presentSubmitInfo.pCommandBufferInfos = &g.presentCommandBufferInfo;
-    g.presentSubmitInfo.signalSemaphoreInfoCount = 1;
-    g.presentSubmitInfo.pSignalSemaphoreInfos = &g.preSemaphore;
+    xcb_map_window(g.connection, g.window);
+    xcb_flush(g.connection);
+}
 
-    g.presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    g.presentInfo.pNext = NULL;
-    g.presentInfo.waitSemaphoreCount = 1;
-    g.presentInfo.pWaitSemaphores = g.unifiedQueue ? &g.renSemaphore.semaphore : &g.preSemaphore.semaphore;
-    g.presentInfo.swapchainCount = 1;
-    g.presentInfo.pSwapchains = &g.swapchain;
-    g.presentInfo.pImageIndices = &g.imageIndex;
-    g.presentInfo.pResults = NULL;
+internal void
+arWindowTeardown(void)
+{
+    xcb_free_cursor(g.connection, g.hiddenCursor);
+    xcb_destroy_window(g.connection, g.window);
+    xcb_disconnect(g.connection);
 }
+#elif defined(AR_PLATFORM_WAYLAND)
+global uint8_t const arEvdevKeys[256] =
+{
+    [1]   = AR_KEY_ESCAPE,
+    [2]   = AR_KEY_1,
+    [3]   = AR_KEY_2,
+    [4]   = AR_KEY_3,
+    [5]   = AR_KEY_4,
+    [6]   = AR_KEY_5,
+    [7]   = AR_KEY_6,
+    [8]   = AR_KEY_7,
+    [9]   = AR_KEY_8,
+    [10]  = AR_KEY_9,
+    [11]  = AR_KEY_0,
+    [12]  = AR_KEY_MINUS,
+    [13]  = AR_KEY_PLUS,
+    [14]  = AR_KEY_BACKSPACE,
+    [15]  = AR_KEY_TAB,
+    [16]  = AR_KEY_Q,
+    [17]  = AR_KEY_W,
+    [18]  = AR_KEY_E,
+    [19]  = AR_KEY_R,
+    [20]  = AR_KEY_T,
+    [21]  = AR_KEY_Y,
+    [22]  = AR_KEY_U,
+    [23]  = AR_KEY_I,
+    [24]  = AR_KEY_O,
+    [25]  = AR_KEY_P,
+    [26]  = AR_KEY_LBRACKET,
+    [27]  = AR_KEY_RBRACKET,
+    [28]  = AR_KEY_ENTER,
+    [29]  = AR_KEY_CTRL,
+    [30]  = AR_KEY_A,
+    [31]  = AR_KEY_S,
+    [32]  = AR_KEY_D,
+    [33]  = AR_KEY_F,
+    [34]  = AR_KEY_G,
+    [35]  = AR_KEY_H,
+    [36]  = AR_KEY_J,
+    [37]  = AR_KEY_K,
+    [38]  = AR_KEY_L,
+    [39]  = AR_KEY_SEMICOLON,
+    [40]  = AR_KEY_APOSTROPHE,
+    [41]  = AR_KEY_GRAVE,
+    [42]  = AR_KEY_SHIFT,
+    [43]  = AR_KEY_BACKSLASH,
+    [44]  = AR_KEY_Z,
+    [45]  = AR_KEY_X,
+    [46]  = AR_KEY_C,
+    [47]  = AR_KEY_V,
+    [48]  = AR_KEY_B,
+    [49]  = AR_KEY_N,
+    [50]  = AR_KEY_M,
+    [51]  = AR_KEY_COMMA,
+    [52]  = AR_KEY_PERIOD,
+    [53]  = AR_KEY_SLASH,
+    [54]  = AR_KEY_SHIFT,
+    [56]  = AR_KEY_ALT,
+    [57]  = AR_KEY_SPACE,
+    [58]  = AR_KEY_CAPS_LOCK,
+    [59]  = AR_KEY_F1,
+    [60]  = AR_KEY_F2,
+    [61]  = AR_KEY_F3,
+    [62]  = AR_KEY_F4,
+    [63]  = AR_KEY_F5,
+    [64]  = AR_KEY_F6,
+    [65]  = AR_KEY_F7,
+    [66]  = AR_KEY_F8,
+    [67]  = AR_KEY_F9,
+    [68]  = AR_KEY_F10,
+    [70]  = AR_KEY_SCROLL_LOCK,
+    [87]  = AR_KEY_F11,
+    [88]  = AR_KEY_F12,
+    [97]  = AR_KEY_CTRL,
+    [99]  = AR_KEY_PRINT_SCREEN,
+    [100] = AR_KEY_ALT,
+    [102] = AR_KEY_HOME,
+    [103] = AR_KEY_UP,
+    [104] = AR_KEY_PAGE_UP,
+    [105] = AR_KEY_LEFT,
+    [106] = AR_KEY_RIGHT,
+    [107] = AR_KEY_END,
+    [108] = AR_KEY_DOWN,
+    [109] = AR_KEY_PAGE_DOWN,
+    [110] = AR_KEY_INSERT,
+    [111] = AR_KEY_DELETE,
+    [119] = AR_KEY_PAUSE,
+    [127] = AR_KEY_MENU,
+    [183] = AR_KEY_F13,
+    [184] = AR_KEY_F14,
+    [185] = AR_KEY_F15,
+    [186] = AR_KEY_F16,
+    [187] = AR_KEY_F17,
+    [188] = AR_KEY_F18,
+    [189] = AR_KEY_F19,
+    [190] = AR_KEY_F20,
+    [191] = AR_KEY_F21,
+    [192] = AR_KEY_F22,
+    [193] = AR_KEY_F23,
+    [194] = AR_KEY_F24
+};
 
 internal void
-arSwapchainTeardown(void)
+arWaylandApplyCursor(void)
 {
-    for (uint32_t i = g.imageCount; i--; )
+    if (!g.pointer)
     {
-        g.vkDestroyImageView(g.device, g.frames[i].view, NULL);
+        return;
     }
 
-    if (!g.unifiedQueue)
+    if (g.cursorHidden || !g.cursorSurface)
     {
-        g.vkDestroyCommandPool(g.device, g.presentCommandPool, NULL);
+        wl_pointer_set_cursor(g.pointer, g.pointerSerial, NULL, 0, 0);
+        return;
     }
 
-    g.vkDestroyCommandPool(g.device, g.graphicsCommandPool, NULL);
-    g.vkDestroySwapchainKHR(g.device, g.swapchain, NULL);
+    struct wl_cursor_image* image = g.cursor->images[0];
+    wl_pointer_set_cursor(g.pointer, g.pointerSerial, g.cursorSurface, (int32_t)image->hotspot_x, (int32_t)image->hotspot_y);
 }
 
 internal void
-arSwapchainRecreate(bool vsync)
+arWaylandPointerEnter(
+    void* data,
+    struct wl_pointer* pointer,
+    uint32_t serial,
+    struct wl_surface* surface,
+    wl_fixed_t x,
+    wl_fixed_t y)
 {
-    uint32_t prevWidth  = g.extent.width;
-    uint32_t prevHeihgt = g.extent.height;
+    g.pointerSerial = serial;
+    g.pointerX = wl_fixed_to_int(x);
+    g.pointerY = wl_fixed_to_int(y);
+    arWaylandApplyCursor();
+}
 
-    arSwapchainTeardown();
-    arSwapchainCreate(vsync);
+internal void
+arWaylandPointerLeave(
+    void* data,
+    struct wl_pointer* pointer,
+    uint32_t serial,
+    struct wl_surface* surface)
+{
+}
 
-    if (prevWidth != g.extent.width || prevHeihgt != g.extent.height)
-    {
-        g.pfnResize();
-    }
+internal void
+arWaylandPointerMotion(
+    void* data,
+    struct wl_pointer* pointer,
+    uint32_t time,
+    wl_fixed_t x,
+    wl_fixed_t y)
+{
+    int pointerX = wl_fixed_to_int(x);
+    int pointerY = wl_fixed_to_int(y);
 
-    arRecordCommands();
+    g.cursorRelX += pointerX - g.pointerX;
+    g.cursorRelY += pointerY - g.pointerY;
+    g.pointerX = pointerX;
+    g.pointerY = pointerY;
 }
 
 internal void
-arContextCreate(void)
+arWaylandPointerButton(
+    void* data,
+    struct wl_pointer* pointer,
+    uint32_t serial,
+    uint32_t time,
+    uint32_t button,
+    uint32_t state)
 {
-    {
-        HMODULE vulkanDll = LoadLibraryA("vulkan-1.dll");
+    ArButton index;
 
-        if (!vulkanDll)
-        {
-            arError("Failed to load vulkan-1.dll");
-        }
+    switch (button)
+    {
+    case 0x110: index = AR_BUTTON_LEFT; break;
+    case 0x111: index = AR_BUTTON_RIGHT; break;
+    case 0x112: index = AR_BUTTON_MIDDLE; break;
+    case 0x113: index = AR_BUTTON_BACKWARD; break;
+    case 0x114: index = AR_BUTTON_FORWARD; break;
+    default: return;
+    }
 
-        g.vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)GetProcAddress(vulkanDll, "vkGetInstanceProcAddr");
-        g.vkCreateInstance = (PFN_vkCreateInstance)g.vkGetInstanceProcAddr(NULL, "vkCreateInstance");
-        g.vkEnumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)g.vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+    if (state == WL_POINTER_BUTTON_STATE_PRESSED)
+    {
+        g.buttons[index].isDown    = true;
+        g.buttons[index].isPressed = true;
     }
+    else
     {
-        uint32_t apiVersion;
-        arVkCheck(g.vkEnumerateInstanceVersion(&apiVersion));
+        g.buttons[index].isDown     = false;
+        g.buttons[index].isReleased = true;
+    }
+}
 
-        if (apiVersion < VK_API_VERSION_1_3)
-        {
-            arError("Vulkan 1.3 required");
-        }
+internal void
+arWaylandPointerAxis(
+    void* data,
+    struct wl_pointer* pointer,
+    uint32_t time,
+    uint32_t axis,
+    wl_fixed_t value)
+{
+}
 
-        char const* instanceExtensions[2];
-        instanceExtensions[0] = VK_KHR_SURFACE_EXTENSION_NAME;
-        instanceExtensions[1] = VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
+global struct wl_pointer_listener const arPointerListener =
+{
+    arWaylandPointerEnter,
+    arWaylandPointerLeave,
+    arWaylandPointerMotion,
+    arWaylandPointerButton,
+    arWaylandPointerAxis
+};
 
-        VkApplicationInfo applicationInfo;
-        applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-        applicationInfo.pNext = NULL;
-        applicationInfo.applicationVersion = 0;
-        applicationInfo.engineVersion = 0;
-        applicationInfo.pEngineName = "arline";
-        applicationInfo.pApplicationName = "arline";
-        applicationInfo.apiVersion = apiVersion;
+internal void
+arWaylandKeyboardKeymap(
+    void* data,
+    struct wl_keyboard* keyboard,
+    uint32_t format,
+    int32_t fd,
+    uint32_t size)
+{
+    close(fd);
+}
 
-        VkInstanceCreateInfo instanceCreateInfo;
-        instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-        instanceCreateInfo.pNext = NULL;
-        instanceCreateInfo.flags = 0;
-        instanceCreateInfo.pApplicationInfo = &applicationInfo;
-        instanceCreateInfo.enabledExtensionCount = 2;
-        instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions;
-        instanceCreateInfo.enabledLayerCount = 0;
-        arVkCheck(g.vkCreateInstance(&instanceCreateInfo, NULL, &g.instance));
-        arLoadInstanceFunctions();
+internal void
+arWaylandKeyboardEnter(
+    void* data,
+    struct wl_keyboard* keyboard,
+    uint32_t serial,
+    struct wl_surface* surface,
+    struct wl_array* keys)
+{
+}
+
+internal void
+arWaylandKeyboardLeave(
+    void* data,
+    struct wl_keyboard* keyboard,
+    uint32_t serial,
+    struct wl_surface* surface)
+{
+    memset(g.keys, 0, sizeof(g.keys));
+    memset(g.buttons, 0, sizeof(g.buttons));
+}
+
+internal void
+arWaylandKeyboardKey(
+    void* data,
+    struct wl_keyboard* keyboard,
+    uint32_t serial,
+    uint32_t time,
+    uint32_t key,
+    uint32_t state)
+{
+    if (key > 255 || !arEvdevKeys[key])
+    {
+        return;
     }
+
+    ArKeyInternal* keyState = &g.keys[arEvdevKeys[key]];
+
+    if (state == WL_KEYBOARD_KEY_STATE_PRESSED)
     {
-        VkWin32SurfaceCreateInfoKHR surfaceCreateInfo;
-        surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-        surfaceCreateInfo.pNext = NULL;
-        surfaceCreateInfo.flags = 0;
-        surfaceCreateInfo.hinstance = g.hinstance;
-        surfaceCreateInfo.hwnd = g.hwnd;
-        arVkCheck(g.vkCreateWin32SurfaceKHR(g.instance, &surfaceCreateInfo, NULL, &g.surface));
+        keyState->isPressed = !keyState->isDown;
+        keyState->isDown = true;
     }
+    else
     {
-        VkPhysicalDevice gpus[64];
-        uint32_t gpuCount;
-        arVkCheck(g.vkEnumeratePhysicalDevices(g.instance, &gpuCount, NULL));
-        gpuCount = min(gpuCount, 64);
-        arVkCheck(g.vkEnumeratePhysicalDevices(g.instance, &gpuCount, gpus));
+        keyState->isDown = false;
+        keyState->isReleased = true;
+    }
+}
 
-        for ( ; gpuCount--; )
-        {
-            VkPhysicalDeviceProperties properties;
-            g.vkGetPhysicalDeviceProperties(gpus[gpuCount], &properties);
+internal void
+arWaylandKeyboardModifiers(
+    void* data,
+    struct wl_keyboard* keyboard,
+    uint32_t serial,
+    uint32_t depressed,
+    uint32_t latched,
+    uint32_t locked,
+    uint32_t group)
+{
+}
 
-            if (properties.apiVersion < VK_API_VERSION_1_3)
-            {
-                continue;
-            }
+global struct wl_keyboard_listener const arKeyboardListener =
+{
+    arWaylandKeyboardKeymap,
+    arWaylandKeyboardEnter,
+    arWaylandKeyboardLeave,
+    arWaylandKeyboardKey,
+    arWaylandKeyboardModifiers
+};
 
-            g.gpu = gpus[gpuCount];
-        }
+internal void
+arWaylandSeatCapabilities(
+    void* data,
+    struct wl_seat* seat,
+    uint32_t capabilities)
+{
+    if ((capabilities & WL_SEAT_CAPABILITY_POINTER) && !g.pointer)
+    {
+        g.pointer = wl_seat_get_pointer(seat);
+        wl_pointer_add_listener(g.pointer, &arPointerListener, NULL);
+    }
+    else if (!(capabilities & WL_SEAT_CAPABILITY_POINTER) && g.pointer)
+    {
+        wl_pointer_destroy(g.pointer);
+        g.pointer = NULL;
+    }
 
-        if (!g.gpu)
-        {
-            arError("No suitable gpu. Try updating drivers");
-        }
+    if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && !g.keyboard)
+    {
+        g.keyboard = wl_seat_get_keyboard(seat);
+        wl_keyboard_add_listener(g.keyboard, &arKeyboardListener, NULL);
+    }
+    else if (!(capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && g.keyboard)
+    {
+        wl_keyboard_destroy(g.keyboard);
+        g.keyboard = NULL;
+    }
+}
 
-        VkQueueFamilyProperties queueProperties[32];
-        uint32_t queuePropertyCount;
-        g.vkGetPhysicalDeviceQueueFamilyProperties(g.gpu, &queuePropertyCount, NULL);
-        queuePropertyCount = min(queuePropertyCount, 32);
-        g.vkGetPhysicalDeviceQueueFamilyProperties(g.gpu, &queuePropertyCount, queueProperties);
+global struct wl_seat_listener const arSeatListener =
+{
+    arWaylandSeatCapabilities
+};
 
-        g.graphicsQueueFamily = ~0u;
-        g.presentQueueFamily  = ~0u;
+internal void
+arWaylandPing(
+    void* data,
+    struct xdg_wm_base* wmBase,
+    uint32_t serial)
+{
+    xdg_wm_base_pong(wmBase, serial);
+}
 
-        for ( ; queuePropertyCount--; )
-        {
-            VkBool32 presentSupported;
-            arVkCheck(g.vkGetPhysicalDeviceSurfaceSupportKHR(
-                g.gpu,
-                queuePropertyCount,
-                g.surface,
-                &presentSupported));
+global struct xdg_wm_base_listener const arWmBaseListener =
+{
+    arWaylandPing
+};
 
-            if ((g.graphicsQueueFamily & ~0u) & (queueProperties[queuePropertyCount].queueFlags & VK_QUEUE_GRAPHICS_BIT))
-            {
-                g.graphicsQueueFamily = queuePropertyCount;
-            }
-            
-            if (presentSupported & (queuePropertyCount != g.graphicsQueueFamily))
-            {
-                g.presentQueueFamily = queuePropertyCount;
-            }
-        }
+internal void
+arWaylandSurfaceConfigure(
+    void* data,
+    struct xdg_surface* surface,
+    uint32_t serial)
+{
+    xdg_surface_ack_configure(surface, serial);
+    g.configured = true;
 
-        if (g.presentQueueFamily & ~0u)
-        {
-            g.presentQueueFamily = g.graphicsQueueFamily;
-            g.unifiedQueue = true;
-        }
-    }
+    if (g.pendingWidth == g.width && g.pendingHeight == g.height)
     {
-        char const* deviceExtensions[1];
-        deviceExtensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+        return;
+    }
 
-        float priorities[1];
-        priorities[0] = 0.0f;
+    g.width = g.pendingWidth;
+    g.height = g.pendingHeight;
+    g.swapchainDirty = g.device != NULL;
+}
 
-        VkDeviceQueueCreateInfo queueCreateInfos[2];
-        queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfos[0].pNext = NULL;
-        queueCreateInfos[0].flags = 0;
-        queueCreateInfos[0].queueCount = 1;
-        queueCreateInfos[0].queueFamilyIndex = g.graphicsQueueFamily;
-        queueCreateInfos[0].pQueuePriorities = priorities;
+global struct xdg_surface_listener const arSurfaceListener =
+{
+    arWaylandSurfaceConfigure
+};
 
-        queueCreateInfos[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfos[1].pNext = NULL;
-        queueCreateInfos[1].flags = 0;
-        queueCreateInfos[1].queueCount = 1;
-        queueCreateInfos[1].queueFamilyIndex = g.presentQueueFamily;
-        queueCreateInfos[1].pQueuePriorities = priorities;
+internal void
+arWaylandToplevelConfigure(
+    void* data,
+    struct xdg_toplevel* toplevel,
+    int32_t width,
+    int32_t height,
+    struct wl_array* states)
+{
+    if (width > 0 && height > 0)
+    {
+        g.pendingWidth = width;
+        g.pendingHeight = height;
+    }
+}
 
-        VkPhysicalDeviceVulkan12Features vulkan12Features;
-        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
-        vulkan12Features.pNext = NULL;
+internal void
+arWaylandToplevelClose(
+    void* data,
+    struct xdg_toplevel* toplevel)
+{
+    g.windowShouldClose = true;
+}
+
+global struct xdg_toplevel_listener const arToplevelListener =
+{
+    arWaylandToplevelConfigure,
+    arWaylandToplevelClose
+};
+
+internal void
+arWaylandRegistryGlobal(
+    void* data,
+    struct wl_registry* registry,
+    uint32_t name,
+    char const* interface,
+    uint32_t version)
+{
+    if (!strcmp(interface, wl_compositor_interface.name))
+    {
+        g.compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 1);
+    }
+    else if (!strcmp(interface, wl_shm_interface.name))
+    {
+        g.shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+    }
+    else if (!strcmp(interface, wl_seat_interface.name) && !g.seat)
+    {
+        g.seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+        wl_seat_add_listener(g.seat, &arSeatListener, NULL);
+    }
+    else if (!strcmp(interface, xdg_wm_base_interface.name))
+    {
+        g.wmBase = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+        xdg_wm_base_add_listener(g.wmBase, &arWmBaseListener, NULL);
+    }
+}
+
+internal void
+arWaylandRegistryGlobalRemove(
+    void* data,
+    struct wl_registry* registry,
+    uint32_t name)
+{
+}
+
+global struct wl_registry_listener const arRegistryListener =
+{
+    arWaylandRegistryGlobal,
+    arWaylandRegistryGlobalRemove
+};
+
+internal void
+arWaylandFrameDone(
+    void* data,
+    struct wl_callback* callback,
+    uint32_t time)
+{
+    wl_callback_destroy(callback);
+    g.frameCallback = NULL;
+}
+
+global struct wl_callback_listener const arFrameListener =
+{
+    arWaylandFrameDone
+};
+
+internal void
+arWaylandRequestFrame(void)
+{
+    if (g.frameCallback)
+    {
+        return;
+    }
+
+    // Requested before vkQueuePresentKHR so the callback rides on the commit made by the present.
+    g.frameCallback = wl_surface_frame(g.frameSurface);
+    wl_callback_add_listener(g.frameCallback, &arFrameListener, NULL);
+}
+
+internal void
+arWaylandWaitFrame(void)
+{
+    struct pollfd fd;
+    fd.fd = wl_display_get_fd(g.display);
+    fd.events = POLLIN;
+
+    // Only the frame queue is dispatched here, input stays queued for arPollEvents.
+    // Hidden surfaces get no callbacks, so give up after a while to keep the loop serviced.
+    while (g.frameCallback)
+    {
+        if (wl_display_prepare_read_queue(g.display, g.frameQueue))
+        {
+            wl_display_dispatch_queue_pending(g.display, g.frameQueue);
+            continue;
+        }
+
+        wl_display_flush(g.display);
+
+        if (poll(&fd, 1, AR_FRAME_CALLBACK_TIMEOUT) <= 0)
+        {
+            wl_display_cancel_read(g.display);
+            break;
+        }
+
+        if (wl_display_read_events(g.display) < 0)
+        {
+            g.windowShouldClose = true;
+            break;
+        }
+    }
+}
+
+internal void
+arWindowCreate(
+    int width,
+    int height)
+{
+    g.display = wl_display_connect(NULL);
+
+    if (!g.display)
+    {
+        arError("Failed to connect to Wayland display");
+    }
+
+    g.width  = width;
+    g.height = height;
+    g.pendingWidth  = width;
+    g.pendingHeight = height;
+
+    g.registry = wl_display_get_registry(g.display);
+    wl_registry_add_listener(g.registry, &arRegistryListener, NULL);
+    wl_display_roundtrip(g.display);
+
+    if (!g.compositor || !g.wmBase)
+    {
+        arError("Wayland compositor does not support xdg_wm_base");
+    }
+
+    wl_display_roundtrip(g.display);
+
+    g.frameQueue = wl_display_create_queue(g.display);
+    g.wlSurface = wl_compositor_create_surface(g.compositor);
+    g.frameSurface = wl_proxy_create_wrapper(g.wlSurface);
+    wl_proxy_set_queue((struct wl_proxy*)g.frameSurface, g.frameQueue);
+
+    g.xdgSurface = xdg_wm_base_get_xdg_surface(g.wmBase, g.wlSurface);
+    xdg_surface_add_listener(g.xdgSurface, &arSurfaceListener, NULL);
+    g.toplevel = xdg_surface_get_toplevel(g.xdgSurface);
+    xdg_toplevel_add_listener(g.toplevel, &arToplevelListener, NULL);
+    xdg_toplevel_set_min_size(g.toplevel, 150, 150);
+    wl_surface_commit(g.wlSurface);
+
+    while (!g.configured)
+    {
+        if (wl_display_dispatch(g.display) < 0)
+        {
+            arError("Failed to configure window");
+        }
+    }
+
+    if (g.shm)
+    {
+        g.cursorTheme = wl_cursor_theme_load(NULL, 24, g.shm);
+    }
+
+    if (g.cursorTheme)
+    {
+        g.cursor = wl_cursor_theme_get_cursor(g.cursorTheme, "left_ptr");
+    }
+
+    if (g.cursor)
+    {
+        g.cursorSurface = wl_compositor_create_surface(g.compositor);
+        wl_surface_attach(g.cursorSurface, wl_cursor_image_get_buffer(g.cursor->images[0]), 0, 0);
+        wl_surface_commit(g.cursorSurface);
+    }
+
+    wl_display_flush(g.display);
+}
+
+internal void
+arWindowTeardown(void)
+{
+    if (g.frameCallback)
+    {
+        wl_callback_destroy(g.frameCallback);
+    }
+
+    if (g.cursorSurface)
+    {
+        wl_surface_destroy(g.cursorSurface);
+    }
+
+    if (g.cursorTheme)
+    {
+        wl_cursor_theme_destroy(g.cursorTheme);
+    }
+
+    if (g.keyboard)
+    {
+        wl_keyboard_destroy(g.keyboard);
+    }
+
+    if (g.pointer)
+    {
+        wl_pointer_destroy(g.pointer);
+    }
+
+    if (g.seat)
+    {
+        wl_seat_destroy(g.seat);
+    }
+
+    if (g.shm)
+    {
+        wl_shm_destroy(g.shm);
+    }
+
+    xdg_toplevel_destroy(g.toplevel);
+    xdg_surface_destroy(g.xdgSurface);
+    wl_proxy_wrapper_destroy(g.frameSurface);
+    wl_surface_destroy(g.wlSurface);
+    wl_event_queue_destroy(g.frameQueue);
+    xdg_wm_base_destroy(g.wmBase);
+    wl_compositor_destroy(g.compositor);
+    wl_registry_destroy(g.registry);
+    wl_display_disconnect(g.display);
+}
+#endif
+
+internal bool
+arHasExtension(
+    VkExtensionProperties const* pExtensions,
+    uint32_t extensionCount,
+    char const* name)
+{
+    for (uint32_t i = extensionCount; i--; )
+    {
+        char const* a = pExtensions[i].extensionName;
+        char const* b = name;
+
+        while (*a && *a == *b)
+        {
+            a += 1;
+            b += 1;
+        }
+
+        if (*a == *b)
+        {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+internal VkPresentModeKHR
+arChoosePresentMode(void)
+{
+    VkPresentModeKHR presentModes[8];
+    uint32_t presentModeCount = 8;
+    arVkCheck(g.vkGetPhysicalDeviceSurfacePresentModesKHR(g.gpu, g.surface, &presentModeCount, presentModes));
+
+    bool mailboxSupported = false;
+    bool immediateSupported = false;
+    bool relaxedSupported = false;
+
+    for ( ; presentModeCount--; )
+    {
+        mailboxSupported |= presentModes[presentModeCount] == VK_PRESENT_MODE_MAILBOX_KHR;
+        immediateSupported |= presentModes[presentModeCount] == VK_PRESENT_MODE_IMMEDIATE_KHR;
+        relaxedSupported |= presentModes[presentModeCount] == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    }
+
+    // FIFO is the only mode every surface supports, anything else falls back to it.
+    switch (g.presentModeRequest)
+    {
+    case AR_PRESENT_MODE_FIFO:
+        return(VK_PRESENT_MODE_FIFO_KHR);
+    case AR_PRESENT_MODE_FIFO_RELAXED:
+        return(relaxedSupported ? VK_PRESENT_MODE_FIFO_RELAXED_KHR : VK_PRESENT_MODE_FIFO_KHR);
+    case AR_PRESENT_MODE_MAILBOX:
+        return(mailboxSupported ? VK_PRESENT_MODE_MAILBOX_KHR : VK_PRESENT_MODE_FIFO_KHR);
+    case AR_PRESENT_MODE_IMMEDIATE:
+        return(immediateSupported ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_FIFO_KHR);
+    default:
+        break;
+    }
+
+#if defined(AR_PLATFORM_WAYLAND)
+    // Frame callbacks pace vsync on Wayland, MAILBOX keeps vkQueuePresentKHR from blocking on top of that.
+    if (g.vsyncEnabled && mailboxSupported)
+    {
+        return(VK_PRESENT_MODE_MAILBOX_KHR);
+    }
+#endif
+
+    if (g.vsyncEnabled)
+    {
+        return(VK_PRESENT_MODE_FIFO_KHR);
+    }
+
+    if (mailboxSupported)
+    {
+        return(VK_PRESENT_MODE_MAILBOX_KHR);
+    }
+
+    return(immediateSupported ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_FIFO_KHR);
+}
+
+internal void
+arSwapchainCreate(
+    bool vsync)
+{
+    g.vsyncEnabled = vsync;
+
+    VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    arVkCheck(g.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(g.gpu, g.surface, &surfaceCapabilities));
+
+    g.extent.width  = surfaceCapabilities.currentExtent.width;
+    g.extent.height = surfaceCapabilities.currentExtent.height;
+
+    if (g.extent.width == 0xffffffff)
+    {
+        g.extent.width  = (uint32_t)g.width;
+        g.extent.height = (uint32_t)g.height;
+        g.extent.width  = max(g.extent.width, surfaceCapabilities.minImageExtent.width);
+        g.extent.height = max(g.extent.height, surfaceCapabilities.minImageExtent.height);
+        g.extent.width  = min(g.extent.width, surfaceCapabilities.maxImageExtent.width);
+        g.extent.height = min(g.extent.height, surfaceCapabilities.maxImageExtent.height);
+    }
+
+    // Every mode the swapchain may later switch to in place has to fit its image count.
+    g.presentMode = arChoosePresentMode();
+    g.compatiblePresentModes[0] = g.presentMode;
+    g.compatiblePresentModeCount = 1;
+
+    uint32_t minImageCount = surfaceCapabilities.minImageCount;
+
+    if (g.swapchainMaintenance1)
+    {
+        VkSurfacePresentModeCompatibilityEXT presentModeCompatibility;
+        presentModeCompatibility.sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_COMPATIBILITY_EXT;
+        presentModeCompatibility.pNext = NULL;
+        presentModeCompatibility.presentModeCount = 8;
+        presentModeCompatibility.pPresentModes = g.compatiblePresentModes;
+
+        VkSurfacePresentModeEXT surfacePresentMode;
+        surfacePresentMode.sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_EXT;
+        surfacePresentMode.pNext = NULL;
+        surfacePresentMode.presentMode = g.presentMode;
+
+        VkPhysicalDeviceSurfaceInfo2KHR surfaceInfo;
+        surfaceInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR;
+        surfaceInfo.pNext = &surfacePresentMode;
+        surfaceInfo.surface = g.surface;
+
+        VkSurfaceCapabilities2KHR surfaceCapabilities2;
+        surfaceCapabilities2.sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR;
+        surfaceCapabilities2.pNext = &presentModeCompatibility;
+        arVkCheck(g.vkGetPhysicalDeviceSurfaceCapabilities2KHR(g.gpu, &surfaceInfo, &surfaceCapabilities2));
+
+        if (presentModeCompatibility.presentModeCount)
+        {
+            g.compatiblePresentModeCount = presentModeCompatibility.presentModeCount;
+        }
+        else
+        {
+            g.compatiblePresentModes[0] = g.presentMode;
+        }
+
+        surfaceCapabilities2.pNext = NULL;
+
+        for (uint32_t i = g.compatiblePresentModeCount; i--; )
+        {
+            surfacePresentMode.presentMode = g.compatiblePresentModes[i];
+            arVkCheck(g.vkGetPhysicalDeviceSurfaceCapabilities2KHR(g.gpu, &surfaceInfo, &surfaceCapabilities2));
+            minImageCount = max(minImageCount, surfaceCapabilities2.surfaceCapabilities.minImageCount);
+        }
+    }
+
+    uint32_t imageCount = g.swapchainImageCount ? g.swapchainImageCount : 3;
+    imageCount = max(imageCount, minImageCount);
+    imageCount = min(imageCount, 6);
+
+    if (surfaceCapabilities.maxImageCount)
+    {
+        imageCount = min(imageCount, surfaceCapabilities.maxImageCount);
+    }
+
+    VkSwapchainPresentModesCreateInfoEXT presentModesCreateInfo;
+    presentModesCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODES_CREATE_INFO_EXT;
+    presentModesCreateInfo.pNext = NULL;
+    presentModesCreateInfo.presentModeCount = g.compatiblePresentModeCount;
+    presentModesCreateInfo.pPresentModes = g.compatiblePresentModes;
+
+    VkSwapchainCreateInfoKHR swapchainCreateInfo;
+    swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapchainCreateInfo.pNext = g.swapchainMaintenance1 ? &presentModesCreateInfo : NULL;
+    swapchainCreateInfo.flags = 0;
+    swapchainCreateInfo.surface = g.surface;
+    swapchainCreateInfo.minImageCount = imageCount;
+    swapchainCreateInfo.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    swapchainCreateInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    swapchainCreateInfo.imageExtent = g.extent;
+    swapchainCreateInfo.imageArrayLayers = 1;
+    swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    swapchainCreateInfo.queueFamilyIndexCount = 0;
+    swapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swapchainCreateInfo.presentMode = g.presentMode;
+    swapchainCreateInfo.clipped = true;
+    swapchainCreateInfo.oldSwapchain = g.swapchain;
+    arVkCheck(g.vkCreateSwapchainKHR(g.device, &swapchainCreateInfo, NULL, &g.swapchain));
+
+    VkCommandBuffer commandBuffers[6];
+    VkCommandBuffer presentCommandBuffers[6];
+    VkImage swapchainImages[6];
+    arVkCheck(g.vkGetSwapchainImagesKHR(g.device, g.swapchain, &g.imageCount, NULL));
+    g.imageCount = min(g.imageCount, 6);
+    arVkCheck(g.vkGetSwapchainImagesKHR(g.device, g.swapchain, &g.imageCount, swapchainImages));
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo;
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.pNext = NULL;
+    commandPoolCreateInfo.flags = 0;
+    commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
+    arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.graphicsCommandPool));
+    g.swapchainFrame = g.frameCounter;
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = NULL;
+    commandBufferAllocateInfo.commandPool = g.graphicsCommandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = g.imageCount;
+    arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, commandBuffers));
+
+    if (!g.unifiedQueue)
+    {
+        commandPoolCreateInfo.queueFamilyIndex = g.presentQueueFamily;
+        arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.presentCommandPool));
+        
+        commandBufferAllocateInfo.commandPool = g.presentCommandPool;
+        arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, presentCommandBuffers));
+    }
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = NULL;
+    semaphoreCreateInfo.flags = 0;
+
+    for (uint32_t i = g.imageCount; i--; )
+    {
+        g.frames[i].cmd = commandBuffers[i];
+        g.frames[i].presentCmd = presentCommandBuffers[i];
+        g.frames[i].image = swapchainImages[i];
+        g.frames[i].frame = 0;
+        g.frames[i].preSemaphore = NULL;
+        arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.frames[i].renSemaphore));
+
+        if (!g.unifiedQueue)
+        {
+            arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.frames[i].preSemaphore));
+        }
+
+        VkImageViewCreateInfo imageViewCreateInfo;
+        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewCreateInfo.pNext = NULL;
+        imageViewCreateInfo.flags = 0;
+        imageViewCreateInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
+        imageViewCreateInfo.image = swapchainImages[i];
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+        arVkCheck(g.vkCreateImageView(g.device, &imageViewCreateInfo, NULL, &g.frames[i].view));
+
+        if (!g.unifiedQueue)
+        {
+            VkCommandBufferBeginInfo commandBufferBeginInfo;
+            commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            commandBufferBeginInfo.pNext = NULL;
+            commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+            commandBufferBeginInfo.pInheritanceInfo = NULL;
+
+            VkImageMemoryBarrier2 imageMemoryBarrier;
+            imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            imageMemoryBarrier.pNext = NULL;
+            imageMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+            imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+            imageMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+            imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            imageMemoryBarrier.srcQueueFamilyIndex = g.graphicsQueueFamily;
+            imageMemoryBarrier.dstQueueFamilyIndex = g.presentQueueFamily;
+            imageMemoryBarrier.image = swapchainImages[i];
+            imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+            imageMemoryBarrier.subresourceRange.levelCount = 1;
+            imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+            imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+            VkDependencyInfo dependencyInfo;
+            dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependencyInfo.pNext = NULL;
+            dependencyInfo.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+            dependencyInfo.memoryBarrierCount = 0;
+            dependencyInfo.bufferMemoryBarrierCount = 0;
+            dependencyInfo.imageMemoryBarrierCount = 1;
+            dependencyInfo.pImageMemoryBarriers = &imageMemoryBarrier;
+
+            arVkCheck(g.vkBeginCommandBuffer(presentCommandBuffers[i], &commandBufferBeginInfo));
+            g.vkCmdPipelineBarrier2(presentCommandBuffers[i], &dependencyInfo);
+            arVkCheck(g.vkEndCommandBuffer(presentCommandBuffers[i]));
+        }
+    }
+
+    g.submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    g.submitInfo.pNext = NULL;
+    g.submitInfo.flags = 0;
+    g.submitInfo.waitSemaphoreInfoCount = 1;
+    g.submitInfo.pWaitSemaphoreInfos = &g.acqSemaphore;
+    g.submitInfo.commandBufferInfoCount = 1;
+    g.submitInfo.pCommandBufferInfos = &g.graphicsCommandBufferInfo;
+    g.submitInfo.signalSemaphoreInfoCount = 2;
+    g.submitInfo.pSignalSemaphoreInfos = g.signalSemaphores;
+
+    g.presentSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    g.presentSubmitInfo.pNext = NULL;
+    g.presentSubmitInfo.flags = 0;
+    g.presentSubmitInfo.waitSemaphoreInfoCount = 1;
+    g.presentSubmitInfo.pWaitSemaphoreInfos = &g.signalSemaphores[0];
+    g.presentSubmitInfo.commandBufferInfoCount = 1;
+    g.presentSubmitInfo.pCommandBufferInfos = &g.presentCommandBufferInfo;
+    g.presentSubmitInfo.signalSemaphoreInfoCount = 1;
+    g.presentSubmitInfo.pSignalSemaphoreInfos = &g.preSemaphore;
+
+    g.presentModeInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODE_INFO_EXT;
+    g.presentModeInfo.pNext = NULL;
+    g.presentModeInfo.swapchainCount = 1;
+    g.presentModeInfo.pPresentModes = &g.presentMode;
+
+    g.presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    g.presentIdInfo.pNext = g.swapchainMaintenance1 ? &g.presentModeInfo : NULL;
+    g.presentIdInfo.swapchainCount = 1;
+    g.presentIdInfo.pPresentIds = &g.presentIdValue;
+
+    g.presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    g.presentInfo.pNext = g.presentWait ? (void const*)&g.presentIdInfo : g.presentIdInfo.pNext;
+    g.presentInfo.waitSemaphoreCount = 1;
+    g.presentInfo.pWaitSemaphores = g.unifiedQueue ? &g.signalSemaphores[0].semaphore : &g.preSemaphore.semaphore;
+    g.presentInfo.swapchainCount = 1;
+    g.presentInfo.pSwapchains = &g.swapchain;
+    g.presentInfo.pImageIndices = &g.imageIndex;
+    g.presentInfo.pResults = NULL;
+}
+
+internal void
+arSwapchainRetire(void)
+{
+    // Without a free slot the retirees are forced out once everything submitted has completed.
+    if (g.retiredSwapchainCount == AR_MAX_RETIRED_SWAPCHAINS)
+    {
+        arWaitFrame(g.frameCounter);
+        arSwapchainCollect(UINT64_MAX);
+    }
+
+    ArRetiredSwapchain* pRetired = &g.retiredSwapchains[g.retiredSwapchainCount++];
+    pRetired->swapchain = g.swapchain;
+    pRetired->graphicsCommandPool = g.graphicsCommandPool;
+    pRetired->presentCommandPool = g.presentCommandPool;
+    pRetired->imageCount = g.imageCount;
+    pRetired->frame = g.frameCounter;
+
+    // Pre-recorded secondaries are replayed by the old chain's command buffers, the new chain records into fresh pools.
+    for (uint32_t i = AR_MAX_RECORDING_THREADS; i--; )
+    {
+        ArRecordingPool* pPool = &g.recordingPools[AR_MAX_FRAMES_IN_FLIGHT][i];
+        pRetired->recordingPools[i] = pPool->pool;
+        pPool->pool = NULL;
+        pPool->commandBufferCount = 0;
+        pPool->usedCount = 0;
+    }
+
+    for (uint32_t i = g.imageCount; i--; )
+    {
+        pRetired->views[i] = g.frames[i].view;
+        pRetired->renSemaphores[i] = g.frames[i].renSemaphore;
+        pRetired->preSemaphores[i] = g.frames[i].preSemaphore;
+    }
+}
+
+internal void
+arSwapchainCollect(
+    uint64_t completed)
+{
+    for (uint32_t i = g.retiredSwapchainCount; i--; )
+    {
+        ArRetiredSwapchain* pRetired = &g.retiredSwapchains[i];
+
+        // The last present on the old chain has to be followed by a completed frame,
+        // otherwise its wait semaphore may still be in use by the presentation engine.
+        if (pRetired->frame >= completed)
+        {
+            continue;
+        }
+
+        for (uint32_t j = pRetired->imageCount; j--; )
+        {
+            g.vkDestroyImageView(g.device, pRetired->views[j], NULL);
+            g.vkDestroySemaphore(g.device, pRetired->renSemaphores[j], NULL);
+
+            if (!g.unifiedQueue)
+            {
+                g.vkDestroySemaphore(g.device, pRetired->preSemaphores[j], NULL);
+            }
+        }
+
+        for (uint32_t j = AR_MAX_RECORDING_THREADS; j--; )
+        {
+            if (pRetired->recordingPools[j])
+            {
+                g.vkDestroyCommandPool(g.device, pRetired->recordingPools[j], NULL);
+            }
+        }
+
+        if (!g.unifiedQueue)
+        {
+            g.vkDestroyCommandPool(g.device, pRetired->presentCommandPool, NULL);
+        }
+
+        g.vkDestroyCommandPool(g.device, pRetired->graphicsCommandPool, NULL);
+        g.vkDestroySwapchainKHR(g.device, pRetired->swapchain, NULL);
+
+        *pRetired = g.retiredSwapchains[--g.retiredSwapchainCount];
+    }
+}
+
+internal void
+arSwapchainTeardown(void)
+{
+    arSwapchainRetire();
+    arSwapchainCollect(UINT64_MAX);
+    g.swapchain = NULL;
+}
+
+internal void
+arSwapchainRecreate(bool vsync)
+{
+    uint32_t prevWidth  = g.extent.width;
+    uint32_t prevHeihgt = g.extent.height;
+
+    // The old chain is handed to the new one and destroyed later, frames in flight keep running.
+    g.swapchainDirty = false;
+    g.swapchainRecreateCount += 1;
+    g.redrawRequested = true;
+    arSwapchainRetire();
+    arSwapchainCreate(vsync);
+
+    // Size-dependent resources are recreated by the application, the old ones go through deferred destruction.
+    if (prevWidth != g.extent.width || prevHeihgt != g.extent.height)
+    {
+        g.pfnResize();
+    }
+
+    arRecordCommands();
+}
+
+internal void
+arHeadlessCreate(void)
+{
+    g.extent.width  = (uint32_t)g.width;
+    g.extent.height = (uint32_t)g.height;
+    g.imageCount = AR_HEADLESS_IMAGE_COUNT;
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo;
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.pNext = NULL;
+    commandPoolCreateInfo.flags = 0;
+    commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
+    arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.graphicsCommandPool));
+
+    VkCommandBuffer commandBuffers[AR_HEADLESS_IMAGE_COUNT];
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = NULL;
+    commandBufferAllocateInfo.commandPool = g.graphicsCommandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = g.imageCount;
+    arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, commandBuffers));
+
+    for (uint32_t i = g.imageCount; i--; )
+    {
+        ArImageCreateInfo imageCreateInfo;
+        imageCreateInfo.usage = AR_IMAGE_USAGE_COLOR_ATTACHMENT;
+        imageCreateInfo.format = AR_FORMAT_UNDEFINED;
+        imageCreateInfo.sampler = AR_SAMPLER_NONE;
+        imageCreateInfo.dstArrayElement = 0;
+        imageCreateInfo.width = g.extent.width;
+        imageCreateInfo.height = g.extent.height;
+        imageCreateInfo.depth = 1;
+        arImageCreate(&g.headlessImages[i], &imageCreateInfo, UINT32_MAX, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+        g.frames[i].cmd = commandBuffers[i];
+        g.frames[i].presentCmd = NULL;
+        g.frames[i].image = g.headlessImages[i].handle.data[0];
+        g.frames[i].view = g.headlessImages[i].handle.data[2];
+        g.frames[i].renSemaphore = NULL;
+        g.frames[i].preSemaphore = NULL;
+        g.frames[i].frame = 0;
+    }
+
+    g.submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    g.submitInfo.pNext = NULL;
+    g.submitInfo.flags = 0;
+    g.submitInfo.waitSemaphoreInfoCount = 0;
+    g.submitInfo.pWaitSemaphoreInfos = NULL;
+    g.submitInfo.commandBufferInfoCount = 1;
+    g.submitInfo.pCommandBufferInfos = &g.graphicsCommandBufferInfo;
+    g.submitInfo.signalSemaphoreInfoCount = 1;
+    g.submitInfo.pSignalSemaphoreInfos = &g.signalSemaphores[1];
+}
+
+internal void
+arHeadlessTeardown(void)
+{
+    for (uint32_t i = g.imageCount; i--; )
+    {
+        arDestroyImage(&g.headlessImages[i]);
+    }
+
+    if (g.headlessReadback.handle.data[0])
+    {
+        arDestroyBuffer(&g.headlessReadback);
+    }
+
+    g.vkDestroyCommandPool(g.device, g.graphicsCommandPool, NULL);
+}
+
+internal void
+arContextCreate(void)
+{
+    {
+#if defined(AR_PLATFORM_WIN32)
+        HMODULE vulkanDll = LoadLibraryA("vulkan-1.dll");
+
+        if (!vulkanDll)
+        {
+            arError("Failed to load vulkan-1.dll");
+        }
+
+        g.vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)GetProcAddress(vulkanDll, "vkGetInstanceProcAddr");
+#elif defined(AR_PLATFORM_POSIX)
+        void* vulkanLibrary = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+
+        if (!vulkanLibrary)
+        {
+            arError("Failed to load libvulkan.so.1");
+        }
+
+        g.vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)dlsym(vulkanLibrary, "vkGetInstanceProcAddr");
+#endif
+        g.vkCreateInstance = (PFN_vkCreateInstance)g.vkGetInstanceProcAddr(NULL, "vkCreateInstance");
+        g.vkEnumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)g.vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+        g.vkEnumerateInstanceExtensionProperties = (PFN_vkEnumerateInstanceExtensionProperties)g.vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceExtensionProperties");
+    }
+    {
+        uint32_t apiVersion;
+        arVkCheck(g.vkEnumerateInstanceVersion(&apiVersion));
+
+        if (apiVersion < VK_API_VERSION_1_3)
+        {
+            arError("Vulkan 1.3 required");
+        }
+
+        char const* instanceExtensions[4];
+        uint32_t instanceExtensionCount = g.headless ? 0 : 2;
+        instanceExtensions[0] = VK_KHR_SURFACE_EXTENSION_NAME;
+        instanceExtensions[1] = AR_SURFACE_EXTENSION_NAME;
+
+        if (!g.headless)
+        {
+            uint32_t extensionCount;
+            arVkCheck(g.vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL));
+
+            VkExtensionProperties* pExtensions = arHostAlloc(max(extensionCount, 1) * sizeof(VkExtensionProperties));
+            arVkCheck(g.vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, pExtensions));
+
+            // Needed to query which present modes a swapchain can switch between in place.
+            if (arHasExtension(pExtensions, extensionCount, VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) &&
+                arHasExtension(pExtensions, extensionCount, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME))
+            {
+                instanceExtensions[instanceExtensionCount++] = VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME;
+                instanceExtensions[instanceExtensionCount++] = VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME;
+                g.surfaceMaintenance1 = true;
+            }
+
+            arHostFree(pExtensions);
+        }
+
+        VkApplicationInfo applicationInfo;
+        applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        applicationInfo.pNext = NULL;
+        applicationInfo.applicationVersion = 0;
+        applicationInfo.engineVersion = 0;
+        applicationInfo.pEngineName = "arline";
+        applicationInfo.pApplicationName = "arline";
+        applicationInfo.apiVersion = apiVersion;
+
+        VkInstanceCreateInfo instanceCreateInfo;
+        instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceCreateInfo.pNext = NULL;
+        instanceCreateInfo.flags = 0;
+        instanceCreateInfo.pApplicationInfo = &applicationInfo;
+        instanceCreateInfo.enabledExtensionCount = instanceExtensionCount;
+        instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions;
+        instanceCreateInfo.enabledLayerCount = 0;
+        arVkCheck(g.vkCreateInstance(&instanceCreateInfo, NULL, &g.instance));
+        arLoadInstanceFunctions();
+    }
+    if (!g.headless)
+    {
+#if defined(AR_PLATFORM_WIN32)
+        VkWin32SurfaceCreateInfoKHR surfaceCreateInfo;
+        surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+        surfaceCreateInfo.pNext = NULL;
+        surfaceCreateInfo.flags = 0;
+        surfaceCreateInfo.hinstance = g.hinstance;
+        surfaceCreateInfo.hwnd = g.hwnd;
+        arVkCheck(g.vkCreateWin32SurfaceKHR(g.instance, &surfaceCreateInfo, NULL, &g.surface));
+#elif defined(AR_PLATFORM_XCB)
+        VkXcbSurfaceCreateInfoKHR surfaceCreateInfo;
+        surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+        surfaceCreateInfo.pNext = NULL;
+        surfaceCreateInfo.flags = 0;
+        surfaceCreateInfo.connection = g.connection;
+        surfaceCreateInfo.window = g.window;
+        arVkCheck(g.vkCreateXcbSurfaceKHR(g.instance, &surfaceCreateInfo, NULL, &g.surface));
+#elif defined(AR_PLATFORM_WAYLAND)
+        VkWaylandSurfaceCreateInfoKHR surfaceCreateInfo;
+        surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
+        surfaceCreateInfo.pNext = NULL;
+        surfaceCreateInfo.flags = 0;
+        surfaceCreateInfo.display = g.display;
+        surfaceCreateInfo.surface = g.wlSurface;
+        arVkCheck(g.vkCreateWaylandSurfaceKHR(g.instance, &surfaceCreateInfo, NULL, &g.surface));
+#endif
+    }
+    {
+        VkPhysicalDevice gpus[64];
+        uint32_t gpuCount;
+        arVkCheck(g.vkEnumeratePhysicalDevices(g.instance, &gpuCount, NULL));
+        gpuCount = min(gpuCount, 64);
+        arVkCheck(g.vkEnumeratePhysicalDevices(g.instance, &gpuCount, gpus));
+
+        for ( ; gpuCount--; )
+        {
+            VkPhysicalDeviceProperties properties;
+            g.vkGetPhysicalDeviceProperties(gpus[gpuCount], &properties);
+
+            if (properties.apiVersion < VK_API_VERSION_1_3)
+            {
+                continue;
+            }
+
+            g.gpu = gpus[gpuCount];
+        }
+
+        if (!g.gpu)
+        {
+            arError("No suitable gpu. Try updating drivers");
+        }
+
+        VkQueueFamilyProperties queueProperties[32];
+        uint32_t queuePropertyCount;
+        g.vkGetPhysicalDeviceQueueFamilyProperties(g.gpu, &queuePropertyCount, NULL);
+        queuePropertyCount = min(queuePropertyCount, 32);
+        g.vkGetPhysicalDeviceQueueFamilyProperties(g.gpu, &queuePropertyCount, queueProperties);
+
+        g.graphicsQueueFamily = ~0u;
+        g.presentQueueFamily  = ~0u;
+        g.transferQueueFamily = ~0u;
+
+        for ( ; queuePropertyCount--; )
+        {
+            VkBool32 presentSupported = false;
+
+            if (!g.headless)
+            {
+                arVkCheck(g.vkGetPhysicalDeviceSurfaceSupportKHR(
+                    g.gpu,
+                    queuePropertyCount,
+                    g.surface,
+                    &presentSupported));
+            }
+
+            if ((g.graphicsQueueFamily & ~0u) & (queueProperties[queuePropertyCount].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                g.graphicsQueueFamily = queuePropertyCount;
+            }
+            
+            if (presentSupported & (queuePropertyCount != g.graphicsQueueFamily))
+            {
+                g.presentQueueFamily = queuePropertyCount;
+            }
+
+            // Transfer-only families map to the copy engines, which run alongside graphics work.
+            if ((queueProperties[queuePropertyCount].queueFlags
+                & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT)) == VK_QUEUE_TRANSFER_BIT)
+            {
+                g.transferQueueFamily = queuePropertyCount;
+            }
+        }
+
+        if (g.transferQueueFamily == ~0u)
+        {
+            g.transferQueueFamily = g.graphicsQueueFamily;
+        }
+
+        g.dedicatedTransfer = g.transferQueueFamily != g.graphicsQueueFamily;
+
+        if (g.presentQueueFamily & ~0u)
+        {
+            g.presentQueueFamily = g.graphicsQueueFamily;
+            g.unifiedQueue = true;
+        }
+
+        arMemoryTypesCreate();
+    }
+    {
+        char const* deviceExtensions[8];
+        uint32_t deviceExtensionCount = g.headless ? 0 : 1;
+        deviceExtensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+        uint32_t extensionCount;
+        arVkCheck(g.vkEnumerateDeviceExtensionProperties(g.gpu, NULL, &extensionCount, NULL));
+
+        VkExtensionProperties* pExtensions = arHostAlloc(max(extensionCount, 1) * sizeof(VkExtensionProperties));
+        arVkCheck(g.vkEnumerateDeviceExtensionProperties(g.gpu, NULL, &extensionCount, pExtensions));
+
+        VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenance1Features;
+        swapchainMaintenance1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+        swapchainMaintenance1Features.pNext = NULL;
+        swapchainMaintenance1Features.swapchainMaintenance1 = false;
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures;
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.pNext = NULL;
+        presentWaitFeatures.presentWait = false;
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures;
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        presentIdFeatures.presentId = false;
+
+        // Only structures of extensions the device exposes may be chained into the query.
+        VkPhysicalDeviceFeatures2 supportedFeatures;
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = NULL;
+
+        if (g.surfaceMaintenance1 && arHasExtension(pExtensions, extensionCount, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME))
+        {
+            swapchainMaintenance1Features.pNext = supportedFeatures.pNext;
+            supportedFeatures.pNext = &swapchainMaintenance1Features;
+        }
+
+        if (!g.headless && g.lowLatency &&
+            arHasExtension(pExtensions, extensionCount, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            arHasExtension(pExtensions, extensionCount, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+        {
+            presentWaitFeatures.pNext = supportedFeatures.pNext;
+            supportedFeatures.pNext = &presentIdFeatures;
+        }
+
+        if (supportedFeatures.pNext)
+        {
+            g.vkGetPhysicalDeviceFeatures2(g.gpu, &supportedFeatures);
+        }
+
+        g.memoryBudget = arHasExtension(pExtensions, extensionCount, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        arHostFree(pExtensions);
+
+        void* pExtensionFeatures = NULL;
+
+        if (g.memoryBudget)
+        {
+            deviceExtensions[deviceExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        }
+
+        if (swapchainMaintenance1Features.swapchainMaintenance1)
+        {
+            deviceExtensions[deviceExtensionCount++] = VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME;
+            swapchainMaintenance1Features.pNext = pExtensionFeatures;
+            pExtensionFeatures = &swapchainMaintenance1Features;
+            g.swapchainMaintenance1 = true;
+        }
+
+        if (presentIdFeatures.presentId && presentWaitFeatures.presentWait)
+        {
+            deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+            deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+            presentWaitFeatures.pNext = pExtensionFeatures;
+            pExtensionFeatures = &presentIdFeatures;
+            g.presentWait = true;
+        }
+
+        float priorities[1];
+        priorities[0] = 0.0f;
+
+        VkDeviceQueueCreateInfo queueCreateInfos[3];
+        queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfos[0].pNext = NULL;
+        queueCreateInfos[0].flags = 0;
+        queueCreateInfos[0].queueCount = 1;
+        queueCreateInfos[0].queueFamilyIndex = g.graphicsQueueFamily;
+        queueCreateInfos[0].pQueuePriorities = priorities;
+
+        queueCreateInfos[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfos[1].pNext = NULL;
+        queueCreateInfos[1].flags = 0;
+        queueCreateInfos[1].queueCount = 1;
+        queueCreateInfos[1].queueFamilyIndex = g.presentQueueFamily;
+        queueCreateInfos[1].pQueuePriorities = priorities;
+
+        uint32_t queueCreateInfoCount = 2 - g.unifiedQueue;
+
+        if (g.dedicatedTransfer && g.transferQueueFamily != g.presentQueueFamily)
+        {
+            queueCreateInfos[queueCreateInfoCount] = queueCreateInfos[0];
+            queueCreateInfos[queueCreateInfoCount].queueFamilyIndex = g.transferQueueFamily;
+            queueCreateInfoCount += 1;
+        }
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features;
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.pNext = pExtensionFeatures;
         vulkan12Features.samplerMirrorClampToEdge = false;
         vulkan12Features.drawIndirectCount = true;
         vulkan12Features.storageBuffer8BitAccess = false;
@@ -931,7 +2864,7 @@ arContextCreate(void)
         vulkan12Features.shaderSubgroupExtendedTypes = false;
         vulkan12Features.separateDepthStencilLayouts = false;
         vulkan12Features.hostQueryReset = false;
-        vulkan12Features.timelineSemaphore = false;
+        vulkan12Features.timelineSemaphore = true;
         vulkan12Features.bufferDeviceAddress = true;
         vulkan12Features.bufferDeviceAddressCaptureReplay = false;
         vulkan12Features.bufferDeviceAddressMultiDevice = false;
@@ -942,1608 +2875,5024 @@ arContextCreate(void)
         vulkan12Features.shaderOutputLayer = false;
         vulkan12Features.subgroupBroadcastDynamicId = false;
 
-        VkPhysicalDeviceVulkan13Features vulkan13Features;
-        vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
-        vulkan13Features.pNext = &vulkan12Features;
-        vulkan13Features.robustImageAccess = false;
-        vulkan13Features.inlineUniformBlock = false;
-        vulkan13Features.descriptorBindingInlineUniformBlockUpdateAfterBind = false;
-        vulkan13Features.pipelineCreationCacheControl = false;
-        vulkan13Features.privateData = false;
-        vulkan13Features.shaderDemoteToHelperInvocation = false;
-        vulkan13Features.shaderTerminateInvocation = false;
-        vulkan13Features.subgroupSizeControl = false;
-        vulkan13Features.computeFullSubgroups = false;
-        vulkan13Features.synchronization2 = true;
-        vulkan13Features.textureCompressionASTC_HDR = false;
-        vulkan13Features.shaderZeroInitializeWorkgroupMemory = false;
-        vulkan13Features.dynamicRendering = true;
-        vulkan13Features.shaderIntegerDotProduct = false;
-        vulkan13Features.maintenance4 = false;
+        VkPhysicalDeviceVulkan13Features vulkan13Features;
+        vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        vulkan13Features.pNext = &vulkan12Features;
+        vulkan13Features.robustImageAccess = false;
+        vulkan13Features.inlineUniformBlock = false;
+        vulkan13Features.descriptorBindingInlineUniformBlockUpdateAfterBind = false;
+        vulkan13Features.pipelineCreationCacheControl = false;
+        vulkan13Features.privateData = false;
+        vulkan13Features.shaderDemoteToHelperInvocation = false;
+        vulkan13Features.shaderTerminateInvocation = false;
+        vulkan13Features.subgroupSizeControl = false;
+        vulkan13Features.computeFullSubgroups = false;
+        vulkan13Features.synchronization2 = true;
+        vulkan13Features.textureCompressionASTC_HDR = false;
+        vulkan13Features.shaderZeroInitializeWorkgroupMemory = false;
+        vulkan13Features.dynamicRendering = true;
+        vulkan13Features.shaderIntegerDotProduct = false;
+        vulkan13Features.maintenance4 = false;
+
+        VkPhysicalDeviceFeatures2 features;
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan13Features;
+        features.features.robustBufferAccess = false;
+        features.features.fullDrawIndexUint32 = true;
+        features.features.imageCubeArray = false;
+        features.features.independentBlend = false;
+        features.features.geometryShader = false;
+        features.features.tessellationShader = false;
+        features.features.sampleRateShading = false;
+        features.features.dualSrcBlend = false;
+        features.features.logicOp = false;
+        features.features.multiDrawIndirect = true;
+        features.features.drawIndirectFirstInstance = true;
+        features.features.depthClamp = false;
+        features.features.depthBiasClamp = false;
+        features.features.fillModeNonSolid = true;
+        features.features.depthBounds = false;
+        features.features.wideLines = false;
+        features.features.largePoints = false;
+        features.features.alphaToOne = false;
+        features.features.multiViewport = false;
+        features.features.samplerAnisotropy = false;
+        features.features.textureCompressionETC2 = false;
+        features.features.textureCompressionASTC_LDR = false;
+        features.features.textureCompressionBC = false;
+        features.features.occlusionQueryPrecise = false;
+        features.features.pipelineStatisticsQuery = false;
+        features.features.vertexPipelineStoresAndAtomics = false;
+        features.features.fragmentStoresAndAtomics = false;
+        features.features.shaderTessellationAndGeometryPointSize = false;
+        features.features.shaderImageGatherExtended = false;
+        features.features.shaderStorageImageExtendedFormats = false;
+        features.features.shaderStorageImageMultisample = false;
+        features.features.shaderStorageImageReadWithoutFormat = false;
+        features.features.shaderStorageImageWriteWithoutFormat = false;
+        features.features.shaderUniformBufferArrayDynamicIndexing = false;
+        features.features.shaderSampledImageArrayDynamicIndexing = false;
+        features.features.shaderStorageBufferArrayDynamicIndexing = false;
+        features.features.shaderStorageImageArrayDynamicIndexing = false;
+        features.features.shaderClipDistance = false;
+        features.features.shaderCullDistance = false;
+        features.features.shaderFloat64 = false;
+        features.features.shaderInt64 = false;
+        features.features.shaderInt16 = false;
+        features.features.shaderResourceResidency = false;
+        features.features.shaderResourceMinLod = false;
+        features.features.sparseBinding = false;
+        features.features.sparseResidencyBuffer = false;
+        features.features.sparseResidencyImage2D = false;
+        features.features.sparseResidencyImage3D = false;
+        features.features.sparseResidency2Samples = false;
+        features.features.sparseResidency4Samples = false;
+        features.features.sparseResidency8Samples = false;
+        features.features.sparseResidency16Samples = false;
+        features.features.sparseResidencyAliased = false;
+        features.features.variableMultisampleRate = false;
+        features.features.inheritedQueries = false;
+
+        VkDeviceCreateInfo deviceCreateInfo;
+        deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceCreateInfo.pNext = &features;
+        deviceCreateInfo.flags = 0;
+        deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
+        deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
+        deviceCreateInfo.enabledLayerCount = 0;
+        deviceCreateInfo.enabledExtensionCount = deviceExtensionCount;
+        deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
+        deviceCreateInfo.pEnabledFeatures = NULL;
+        arVkCheck(g.vkCreateDevice(g.gpu, &deviceCreateInfo, NULL, &g.device));
+        arLoadDeviceFunctions();
+
+        g.vkGetDeviceQueue(g.device, g.graphicsQueueFamily, 0, &g.graphicsQueue);
+        g.vkGetDeviceQueue(g.device, g.presentQueueFamily,  0, &g.presentQueue);
+        g.vkGetDeviceQueue(g.device, g.transferQueueFamily, 0, &g.transferQueue);
+    }
+    {
+        VkCommandPoolCreateInfo commandPoolCreateInfo;
+        commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolCreateInfo.pNext = NULL;
+        commandPoolCreateInfo.flags = 0;
+        commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
+
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.pNext = NULL;
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandBufferCount = 1;
+
+        // Copies are recorded for the transfer queue, ownership acquires for the graphics queue.
+        for (uint32_t i = AR_TRANSFER_SLOT_COUNT; i--; )
+        {
+            commandPoolCreateInfo.queueFamilyIndex = g.transferQueueFamily;
+            arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.transfers[i].pool));
+
+            commandBufferAllocateInfo.commandPool = g.transfers[i].pool;
+            arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, &g.transfers[i].cmd));
+            g.transfers[i].acquirePool = VK_NULL_HANDLE;
+            g.transfers[i].acquireCmd = VK_NULL_HANDLE;
+            g.transfers[i].stagingEnd = 0;
+            g.transfers[i].value = 0;
+
+            if (g.dedicatedTransfer)
+            {
+                commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
+                arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.transfers[i].acquirePool));
+
+                commandBufferAllocateInfo.commandPool = g.transfers[i].acquirePool;
+                arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, &g.transfers[i].acquireCmd));
+            }
+        }
+
+        // Immediate mode records one command buffer per frame slot instead of one per image.
+        commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
+
+        for (uint32_t i = g.immediateRecording ? g.framesInFlight : 0; i--; )
+        {
+            arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.framePools[i]));
+
+            commandBufferAllocateInfo.commandPool = g.framePools[i];
+            arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, &g.frameCommandBuffers[i]));
+        }
+    }
+    {
+        VkSemaphoreCreateInfo semaphoreCreateInfo;
+        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreCreateInfo.pNext = NULL;
+        semaphoreCreateInfo.flags = 0;
+
+        for (uint32_t i = g.framesInFlight; i--; )
+        {
+            arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.acqSemaphores[i]));
+        }
+
+        VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+        semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        semaphoreTypeCreateInfo.pNext = NULL;
+        semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        semaphoreTypeCreateInfo.initialValue = 0;
+
+        semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+        arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.timeline));
+        arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.uploadTimeline));
+        arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.acquireTimeline));
+    }
+    {
+        VkDescriptorPoolSize poolSizes[1];
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = 500000;
+
+        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCreateInfo.pNext = NULL;
+        descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        descriptorPoolCreateInfo.maxSets = 1;
+        descriptorPoolCreateInfo.poolSizeCount = 1;
+        descriptorPoolCreateInfo.pPoolSizes = poolSizes;
+        arVkCheck(g.vkCreateDescriptorPool(g.device, &descriptorPoolCreateInfo, NULL, &g.descriptorPool));
+
+        VkDescriptorBindingFlags bindingFlags[1];
+        bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo descriptorSetLayoutBindingFlags;
+        descriptorSetLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        descriptorSetLayoutBindingFlags.pNext = NULL;
+        descriptorSetLayoutBindingFlags.bindingCount = 1;
+        descriptorSetLayoutBindingFlags.pBindingFlags = bindingFlags;
+
+        VkDescriptorSetLayoutBinding bindings[1];
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = 500000;
+        bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings[0].pImmutableSamplers = NULL;
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.pNext = &descriptorSetLayoutBindingFlags;
+        descriptorSetLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        descriptorSetLayoutCreateInfo.bindingCount = 1;
+        descriptorSetLayoutCreateInfo.pBindings = bindings;
+        arVkCheck(g.vkCreateDescriptorSetLayout(g.device, &descriptorSetLayoutCreateInfo, NULL, &g.descriptorSetLayout));
+
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocateInfo.pNext = NULL;
+        descriptorSetAllocateInfo.descriptorPool = g.descriptorPool;
+        descriptorSetAllocateInfo.descriptorSetCount = 1;
+        descriptorSetAllocateInfo.pSetLayouts = &g.descriptorSetLayout;
+        arVkCheck(g.vkAllocateDescriptorSets(g.device, &descriptorSetAllocateInfo, &g.descriptorSet));
+    }
+    {
+        VkPushConstantRange pushConstantRange;
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = 128;
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCreateInfo.pNext = NULL;
+        pipelineLayoutCreateInfo.flags = 0;
+        pipelineLayoutCreateInfo.setLayoutCount = 1;
+        pipelineLayoutCreateInfo.pSetLayouts = &g.descriptorSetLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+        arVkCheck(g.vkCreatePipelineLayout(g.device, &pipelineLayoutCreateInfo, NULL, &g.pipelineLayout));
+    }
+    {
+        VkSamplerCreateInfo samplerCreateInfo;
+        samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerCreateInfo.pNext = NULL;
+        samplerCreateInfo.flags = 0;
+        samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+        samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.mipLodBias = 0.0f;
+        samplerCreateInfo.anisotropyEnable = false;
+        samplerCreateInfo.maxAnisotropy = 0.0f;
+        samplerCreateInfo.compareEnable = false;
+        samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+        samplerCreateInfo.minLod = 0.0f;
+        samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+        samplerCreateInfo.unnormalizedCoordinates = false;
+        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerLinearToEdge));
+
+        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerLinearRepeat));
+
+        samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerNearestRepeat));
+
+        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerNearestToEdge));
+    }
+    if (g.headless)
+    {
+        arHeadlessCreate();
+    }
+    else
+    {
+        arSwapchainCreate(g.vsyncEnabled);
+    }
+    {
+        arCreateMappedBuffer(&g.transientBuffer, g.transientSize * g.framesInFlight, AR_MEMORY_CATEGORY_STAGING, AR_MEMORY_USAGE_UPLOAD);
+        arCreateMappedBuffer(&g.stagingBuffer, AR_STAGING_SIZE, AR_MEMORY_CATEGORY_STAGING, AR_MEMORY_USAGE_STAGING);
+    }
+    {
+        g.graphicsCommandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        g.graphicsCommandBufferInfo.pNext = NULL;
+        g.graphicsCommandBufferInfo.deviceMask = 0;
+
+        g.presentCommandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        g.presentCommandBufferInfo.pNext = NULL;
+        g.presentCommandBufferInfo.deviceMask = 0;
+
+        g.acqSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        g.acqSemaphore.pNext = NULL;
+        g.acqSemaphore.value = 0;
+        g.acqSemaphore.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        g.acqSemaphore.deviceIndex = 0;
+
+        g.signalSemaphores[0].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        g.signalSemaphores[0].pNext = NULL;
+        g.signalSemaphores[0].value = 0;
+        g.signalSemaphores[0].stageMask = g.unifiedQueue ? VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        g.signalSemaphores[0].deviceIndex = 0;
+
+        g.signalSemaphores[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        g.signalSemaphores[1].pNext = NULL;
+        g.signalSemaphores[1].semaphore = g.timeline;
+        g.signalSemaphores[1].value = 0;
+        g.signalSemaphores[1].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        g.signalSemaphores[1].deviceIndex = 0;
+
+        g.preSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        g.preSemaphore.pNext = NULL;
+        g.preSemaphore.value = 0;
+        g.preSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        g.preSemaphore.deviceIndex = 0;
+    }
+}
+
+internal void
+arContextTeardown(void)
+{
+    if (g.headless)
+    {
+        arHeadlessTeardown();
+    }
+    else
+    {
+        arSwapchainTeardown();
+    }
+
+    arDeferredCollect(UINT64_MAX, UINT64_MAX);
+    arHostFree(g.pDeferred);
+
+    for (uint32_t i = AR_MAX_TRANSIENT_SLOTS; i--; )
+    {
+        if (g.transientSlots[i].pAllocation)
+        {
+            arFreeMemory(g.transientSlots[i].pAllocation);
+        }
+
+        if (g.transientSlots[i].pRetiredAllocation)
+        {
+            arFreeMemory(g.transientSlots[i].pRetiredAllocation);
+        }
+    }
+
+    if (g.commandStream.pData)
+    {
+        arHostFree(g.commandStream.pData);
+    }
+
+    arDestroyBuffer(&g.stagingBuffer);
+    arDestroyBuffer(&g.transientBuffer);
+    g.vkDestroyPipelineLayout(g.device, g.pipelineLayout, NULL);
+    g.vkDestroySampler(g.device, g.samplerNearestRepeat, NULL);
+    g.vkDestroySampler(g.device, g.samplerNearestToEdge, NULL);
+    g.vkDestroySampler(g.device, g.samplerLinearRepeat, NULL);
+    g.vkDestroySampler(g.device, g.samplerLinearToEdge, NULL);
+    g.vkDestroyDescriptorSetLayout(g.device, g.descriptorSetLayout, NULL);
+    g.vkDestroyDescriptorPool(g.device, g.descriptorPool, NULL);
+
+    for (uint32_t i = g.framesInFlight; i--; )
+    {
+        g.vkDestroySemaphore(g.device, g.acqSemaphores[i], NULL);
+    }
+
+    for (uint32_t i = g.immediateRecording ? g.framesInFlight : 0; i--; )
+    {
+        g.vkDestroyCommandPool(g.device, g.framePools[i], NULL);
+    }
+
+    for (uint32_t i = AR_MAX_FRAMES_IN_FLIGHT + 1; i--; )
+    {
+        for (uint32_t j = AR_MAX_RECORDING_THREADS; j--; )
+        {
+            if (g.recordingPools[i][j].pool)
+            {
+                g.vkDestroyCommandPool(g.device, g.recordingPools[i][j].pool, NULL);
+            }
+        }
+    }
+
+    for (uint32_t i = AR_TRANSFER_SLOT_COUNT; i--; )
+    {
+        g.vkDestroyCommandPool(g.device, g.transfers[i].acquirePool, NULL);
+        g.vkDestroyCommandPool(g.device, g.transfers[i].pool, NULL);
+    }
+
+    g.vkDestroySemaphore(g.device, g.acquireTimeline, NULL);
+    g.vkDestroySemaphore(g.device, g.uploadTimeline, NULL);
+    g.vkDestroySemaphore(g.device, g.timeline, NULL);
+    arMemoryTeardown();
+    g.vkDestroyDevice(g.device, NULL);
+    g.vkDestroySurfaceKHR(g.instance, g.surface, NULL);
+    g.vkDestroyInstance(g.instance, NULL);
+}
+
+internal void
+arRecordCommands(void)
+{
+    // In immediate mode every frame is recorded right before it is submitted.
+    if (g.immediateRecording)
+    {
+        return;
+    }
+
+    // A freshly created swapchain's pools were never submitted, so only re-recording has to drain.
+    if (g.frameCounter != g.swapchainFrame)
+    {
+        arWaitFrame(g.frameCounter);
+    }
+
+    arVkCheck(g.vkResetCommandPool(g.device, g.graphicsCommandPool, 0));
+
+    // The user's commands are recorded once and replayed into every image's command buffer.
+    arResetRecordingPools(AR_MAX_FRAMES_IN_FLIGHT, 0);
+    g.commandStream.size = 0;
+    g.renderingOffset = SIZE_MAX;
+    g.pfnRecordCommands();
+
+    for (uint32_t i = g.imageCount; i--; )
+    {
+        VkCommandBufferBeginInfo commandBufferBeginInfo;
+        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        commandBufferBeginInfo.pNext = NULL;
+        commandBufferBeginInfo.flags = 0;
+        commandBufferBeginInfo.pInheritanceInfo = NULL;
+
+        g.pFrame = &g.frames[i];
+
+        arVkCheck(g.vkBeginCommandBuffer(g.pFrame->cmd, &commandBufferBeginInfo));
+        g.vkCmdBindDescriptorSets(
+            g.pFrame->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            g.pipelineLayout, 0, 1, &g.descriptorSet, 0, NULL);
+        arCommandReplay(&g.commandStream, g.pFrame->cmd);
+        arVkCheck(g.vkEndCommandBuffer(g.pFrame->cmd));
+    }
+}
+
+internal void
+arRecordFrame(void)
+{
+    // Resets keep the pool's memory around for the next frame. Every so often it is released,
+    // so a single heavy frame does not pin its peak allocation forever.
+    VkCommandPoolResetFlags resetFlags = 0;
+
+    if (g.frameCounter % AR_FRAME_POOL_RELEASE_INTERVAL < g.framesInFlight)
+    {
+        resetFlags = VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT;
+    }
+
+    VkCommandBuffer cmd = g.frameCommandBuffers[g.frameIndex];
+    arVkCheck(g.vkResetCommandPool(g.device, g.framePools[g.frameIndex], resetFlags));
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = NULL;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = NULL;
+
+    arVkCheck(g.vkBeginCommandBuffer(cmd, &commandBufferBeginInfo));
+    g.vkCmdBindDescriptorSets(
+        cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        g.pipelineLayout, 0, 1, &g.descriptorSet, 0, NULL);
+
+    arResetRecordingPools(g.frameIndex, resetFlags);
+    g.commandStream.size = 0;
+    g.renderingOffset = SIZE_MAX;
+    g.pfnRecordCommands();
+    arCommandReplay(&g.commandStream, cmd);
+    arVkCheck(g.vkEndCommandBuffer(cmd));
+}
+
+internal void
+arResetRecordingPools(
+    uint32_t set,
+    VkCommandPoolResetFlags flags)
+{
+    g.recordingSet = set;
+
+    for (uint32_t i = AR_MAX_RECORDING_THREADS; i--; )
+    {
+        ArRecordingPool* pPool = &g.recordingPools[set][i];
+
+        if (pPool->usedCount)
+        {
+            arVkCheck(g.vkResetCommandPool(g.device, pPool->pool, flags));
+            pPool->usedCount = 0;
+        }
+    }
+}
+
+internal void*
+arCommandPush(
+    ArCommandStream* pStream,
+    ArCommandType type,
+    size_t size)
+{
+    size = (sizeof(ArCommand) + size + 7) & ~(size_t)7;
+
+    if (pStream->size + size > pStream->capacity)
+    {
+        size_t capacity = pStream->capacity ? pStream->capacity : 64 << 10;
+
+        while (pStream->size + size > capacity)
+        {
+            capacity *= 2;
+        }
+
+        char* pData = arHostAlloc(capacity);
+
+        if (pStream->pData)
+        {
+            memcpy(pData, pStream->pData, pStream->size);
+            arHostFree(pStream->pData);
+        }
+
+        pStream->pData = pData;
+        pStream->capacity = capacity;
+    }
+
+    ArCommand* pCommand = (ArCommand*)(pStream->pData + pStream->size);
+    pCommand->type = type;
+    pCommand->size = (uint32_t)size;
+    pStream->size += size;
+
+    return(pCommand + 1);
+}
+
+internal void
+arCommandReplay(
+    ArCommandStream const* pStream,
+    VkCommandBuffer cmd)
+{
+    for (size_t offset = 0; offset < pStream->size; )
+    {
+        ArCommand const* pCommand = (ArCommand const*)(pStream->pData + offset);
+        void const* pPayload = pCommand + 1;
+        offset += pCommand->size;
+
+        switch ((ArCommandType)pCommand->type)
+        {
+        case AR_COMMAND_BEGIN_RENDERING:
+        {
+            ArCommandBeginRendering const* pArgs = pPayload;
+            VkRenderingAttachmentInfo attachments[8];
+
+            for (uint32_t i = 0; i < pArgs->colorAttachmentCount; ++i)
+            {
+                attachments[i] = pArgs->colorAttachments[i];
+
+                if (!attachments[i].imageView)
+                {
+                    attachments[i].imageView = g.pFrame->view;
+                }
+            }
+
+            VkRenderingInfo renderingInfo;
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.pNext = NULL;
+            renderingInfo.flags = pArgs->flags;
+            renderingInfo.renderArea.offset.x = 0;
+            renderingInfo.renderArea.offset.y = 0;
+            renderingInfo.renderArea.extent = pArgs->extent;
+            renderingInfo.layerCount = 1;
+            renderingInfo.viewMask = 0;
+            renderingInfo.colorAttachmentCount = pArgs->colorAttachmentCount;
+            renderingInfo.pColorAttachments = attachments;
+            renderingInfo.pDepthAttachment = pArgs->hasDepthAttachment ? &pArgs->depthAttachment : NULL;
+            renderingInfo.pStencilAttachment = NULL;
+            g.vkCmdBeginRendering(cmd, &renderingInfo);
+
+            // Secondaries set their own viewport and scissor, and nothing else may be recorded inline.
+            if (pArgs->flags & VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT)
+            {
+                break;
+            }
+
+            VkRect2D scissor;
+            scissor.offset.x = 0;
+            scissor.offset.y = 0;
+            scissor.extent = pArgs->extent;
+            g.vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+            VkViewport viewport;
+            viewport.x = 0.0f;
+            viewport.y = 0.0f;
+            viewport.width  = (float)pArgs->extent.width;
+            viewport.height = (float)pArgs->extent.height;
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            g.vkCmdSetViewport(cmd, 0, 1, &viewport);
+        } break;
+        case AR_COMMAND_END_RENDERING:
+        {
+            g.vkCmdEndRendering(cmd);
+        } break;
+        case AR_COMMAND_PUSH_CONSTANTS:
+        {
+            ArCommandPushConstants const* pArgs = pPayload;
+            g.vkCmdPushConstants(
+                cmd,
+                g.pipelineLayout,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                pArgs->offset,
+                pArgs->size,
+                pArgs->values);
+        } break;
+        case AR_COMMAND_BIND_INDEX_BUFFER:
+        {
+            ArCommandBindIndexBuffer const* pArgs = pPayload;
+            g.vkCmdBindIndexBuffer(cmd, pArgs->buffer, pArgs->offset, pArgs->indexType);
+        } break;
+        case AR_COMMAND_BIND_PIPELINE:
+        {
+            ArCommandBindPipeline const* pArgs = pPayload;
+            g.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pArgs->pipeline);
+        } break;
+        case AR_COMMAND_PIPELINE_BARRIER:
+        {
+            ArCommandPipelineBarrier const* pArgs = pPayload;
+            VkImageMemoryBarrier2 imageMemoryBarriers[8];
+
+            for (uint32_t i = 0; i < pArgs->barrierCount; ++i)
+            {
+                imageMemoryBarriers[i] = pArgs->barriers[i];
+
+                if (!imageMemoryBarriers[i].image)
+                {
+                    imageMemoryBarriers[i].image = g.pFrame->image;
+                }
+            }
+
+            VkDependencyInfo dependencyInfo;
+            dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependencyInfo.pNext = NULL;
+            dependencyInfo.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+            dependencyInfo.memoryBarrierCount = 0;
+            dependencyInfo.bufferMemoryBarrierCount = 0;
+            dependencyInfo.imageMemoryBarrierCount = pArgs->barrierCount;
+            dependencyInfo.pImageMemoryBarriers = imageMemoryBarriers;
+            g.vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+        } break;
+        case AR_COMMAND_DRAW:
+        {
+            ArCommandDraw const* pArgs = pPayload;
+            g.vkCmdDraw(cmd, pArgs->vertexCount, pArgs->instanceCount, pArgs->firstVertex, pArgs->firstInstance);
+        } break;
+        case AR_COMMAND_DRAW_INDIRECT:
+        {
+            ArCommandDrawIndirect const* pArgs = pPayload;
+            g.vkCmdDrawIndirect(cmd, pArgs->buffer, pArgs->offset, pArgs->drawCount, pArgs->stride);
+        } break;
+        case AR_COMMAND_DRAW_INDIRECT_COUNT:
+        {
+            ArCommandDrawIndirect const* pArgs = pPayload;
+            g.vkCmdDrawIndirectCount(
+                cmd,
+                pArgs->buffer,
+                pArgs->offset,
+                pArgs->countBuffer,
+                pArgs->countBufferOffset,
+                pArgs->drawCount,
+                pArgs->stride);
+        } break;
+        case AR_COMMAND_DRAW_INDEXED:
+        {
+            ArCommandDrawIndexed const* pArgs = pPayload;
+            g.vkCmdDrawIndexed(
+                cmd,
+                pArgs->indexCount,
+                pArgs->instanceCount,
+                pArgs->firstIndex,
+                pArgs->vertexOffset,
+                pArgs->firstInstance);
+        } break;
+        case AR_COMMAND_DRAW_INDEXED_INDIRECT:
+        {
+            ArCommandDrawIndirect const* pArgs = pPayload;
+            g.vkCmdDrawIndexedIndirect(cmd, pArgs->buffer, pArgs->offset, pArgs->drawCount, pArgs->stride);
+        } break;
+        case AR_COMMAND_DRAW_INDEXED_INDIRECT_COUNT:
+        {
+            ArCommandDrawIndirect const* pArgs = pPayload;
+            g.vkCmdDrawIndexedIndirectCount(
+                cmd,
+                pArgs->buffer,
+                pArgs->offset,
+                pArgs->countBuffer,
+                pArgs->countBufferOffset,
+                pArgs->drawCount,
+                pArgs->stride);
+        } break;
+        case AR_COMMAND_EXECUTE_COMMANDS:
+        {
+            ArCommandExecuteCommands const* pArgs = pPayload;
+            g.vkCmdExecuteCommands(cmd, pArgs->commandBufferCount, pArgs->commandBuffers);
+        } break;
+        }
+    }
+}
+
+internal void
+arBeginTransfer(void)
+{
+    // Each slot is reused every AR_TRANSFER_SLOT_COUNT submits, so only its previous submit has to retire.
+    uint64_t const value = g.uploadCounter + 1;
+
+    if (value > AR_TRANSFER_SLOT_COUNT)
+    {
+        arWaitUpload(value - AR_TRANSFER_SLOT_COUNT);
+
+        if (g.dedicatedTransfer)
+        {
+            arWaitTimeline(g.acquireTimeline, value - AR_TRANSFER_SLOT_COUNT);
+        }
+    }
+
+    // Reclaim while the slot still remembers where its previous submit ended.
+    arStagingReclaim();
+    g.pTransfer = &g.transfers[value % AR_TRANSFER_SLOT_COUNT];
+    arVkCheck(g.vkResetCommandPool(g.device, g.pTransfer->pool, 0));
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = NULL;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = NULL;
+    arVkCheck(g.vkBeginCommandBuffer(g.pTransfer->cmd, &commandBufferBeginInfo));
+
+    if (g.dedicatedTransfer)
+    {
+        arVkCheck(g.vkResetCommandPool(g.device, g.pTransfer->acquirePool, 0));
+        arVkCheck(g.vkBeginCommandBuffer(g.pTransfer->acquireCmd, &commandBufferBeginInfo));
+    }
+}
+
+internal void
+arEndTransfer(void)
+{
+    // Without a dedicated queue, frames are submitted to the same queue later and a barrier is enough
+    // to make the copies visible to them. Otherwise the ownership release and acquire take care of it.
+    VkMemoryBarrier2 memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+    VkDependencyInfo dependencyInfo;
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = NULL;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    dependencyInfo.bufferMemoryBarrierCount = 0;
+    dependencyInfo.imageMemoryBarrierCount = 0;
+
+    if (g.dedicatedTransfer)
+    {
+        arVkCheck(g.vkEndCommandBuffer(g.pTransfer->acquireCmd));
+    }
+    else
+    {
+        g.vkCmdPipelineBarrier2(g.pTransfer->cmd, &dependencyInfo);
+    }
+
+    arVkCheck(g.vkEndCommandBuffer(g.pTransfer->cmd));
+
+    g.pTransfer->value = ++g.uploadCounter;
+    g.pTransfer->stagingEnd = g.stagingHead;
+
+    VkCommandBufferSubmitInfo commandBufferInfo;
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    commandBufferInfo.pNext = NULL;
+    commandBufferInfo.deviceMask = 0;
+    commandBufferInfo.commandBuffer = g.pTransfer->cmd;
+
+    VkSemaphoreSubmitInfo signalSemaphoreInfo;
+    signalSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signalSemaphoreInfo.pNext = NULL;
+    signalSemaphoreInfo.semaphore = g.uploadTimeline;
+    signalSemaphoreInfo.value = g.uploadCounter;
+    signalSemaphoreInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    signalSemaphoreInfo.deviceIndex = 0;
+
+    // Copies over data that submitted frames may still read start once those frames have completed.
+    VkSemaphoreSubmitInfo waitSemaphoreInfo;
+    waitSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    waitSemaphoreInfo.pNext = NULL;
+    waitSemaphoreInfo.semaphore = g.timeline;
+    waitSemaphoreInfo.value = g.transferWaitFrame;
+    waitSemaphoreInfo.stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    waitSemaphoreInfo.deviceIndex = 0;
+
+    VkSubmitInfo2 submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.pNext = NULL;
+    submitInfo.flags = 0;
+    submitInfo.waitSemaphoreInfoCount = g.transferWaitFrame ? 1 : 0;
+    submitInfo.pWaitSemaphoreInfos = &waitSemaphoreInfo;
+    submitInfo.commandBufferInfoCount = 1;
+    submitInfo.pCommandBufferInfos = &commandBufferInfo;
+    submitInfo.signalSemaphoreInfoCount = 1;
+    submitInfo.pSignalSemaphoreInfos = &signalSemaphoreInfo;
+    arVkCheck(g.vkQueueSubmit2(g.transferQueue, 1, &submitInfo, NULL));
+    g.pTransfer = NULL;
+}
+
+internal void
+arFlushAcquires(
+    uint64_t value)
+{
+    // The open transfer's acquires are still being recorded.
+    value = min(value, g.uploadCounter);
+
+    if (!g.dedicatedTransfer || value <= g.acquireCounter)
+    {
+        return;
+    }
+
+    // Every upload submitted so far up to value gets its ownership acquired in one graphics submit.
+    // Later graphics work is ordered behind it, even if the copies are still running.
+    VkCommandBufferSubmitInfo commandBufferInfos[AR_TRANSFER_SLOT_COUNT];
+    uint32_t commandBufferInfoCount = 0;
+
+    for (uint64_t i = g.acquireCounter + 1; i <= value; ++i)
+    {
+        VkCommandBufferSubmitInfo* pInfo = &commandBufferInfos[commandBufferInfoCount++];
+        pInfo->sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        pInfo->pNext = NULL;
+        pInfo->deviceMask = 0;
+        pInfo->commandBuffer = g.transfers[i % AR_TRANSFER_SLOT_COUNT].acquireCmd;
+    }
+
+    VkSemaphoreSubmitInfo waitSemaphoreInfo;
+    waitSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    waitSemaphoreInfo.pNext = NULL;
+    waitSemaphoreInfo.semaphore = g.uploadTimeline;
+    waitSemaphoreInfo.value = value;
+    waitSemaphoreInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    waitSemaphoreInfo.deviceIndex = 0;
+
+    VkSemaphoreSubmitInfo signalSemaphoreInfo;
+    signalSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signalSemaphoreInfo.pNext = NULL;
+    signalSemaphoreInfo.semaphore = g.acquireTimeline;
+    signalSemaphoreInfo.value = value;
+    signalSemaphoreInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    signalSemaphoreInfo.deviceIndex = 0;
+
+    VkSubmitInfo2 submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.pNext = NULL;
+    submitInfo.flags = 0;
+    submitInfo.waitSemaphoreInfoCount = 1;
+    submitInfo.pWaitSemaphoreInfos = &waitSemaphoreInfo;
+    submitInfo.commandBufferInfoCount = commandBufferInfoCount;
+    submitInfo.pCommandBufferInfos = commandBufferInfos;
+    submitInfo.signalSemaphoreInfoCount = 1;
+    submitInfo.pSignalSemaphoreInfos = &signalSemaphoreInfo;
+    arVkCheck(g.vkQueueSubmit2(g.graphicsQueue, 1, &submitInfo, NULL));
+    g.acquireCounter = value;
+}
+
+internal void
+arWaitTimeline(
+    VkSemaphore semaphore,
+    uint64_t value)
+{
+    VkSemaphoreWaitInfo semaphoreWaitInfo;
+    semaphoreWaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    semaphoreWaitInfo.pNext = NULL;
+    semaphoreWaitInfo.flags = 0;
+    semaphoreWaitInfo.semaphoreCount = 1;
+    semaphoreWaitInfo.pSemaphores = &semaphore;
+    semaphoreWaitInfo.pValues = &value;
+
+    if (g.vkWaitSemaphores(g.device, &semaphoreWaitInfo, UINT64_MAX))
+    {
+        arError("Failed to sync");
+    }
+}
+
+internal void
+arStagingReclaim(void)
+{
+    // With a dedicated queue, buffer updates also copy out of the ring on the graphics side,
+    // so a submit only retires once its acquires have completed.
+    uint64_t completed;
+    arVkCheck(g.vkGetSemaphoreCounterValue(g.device, g.dedicatedTransfer ? g.acquireTimeline : g.uploadTimeline, &completed));
+
+    // Submits retire in order, so everything up to the end of the last completed one is free again.
+    ArTransfer const* pTransfer = &g.transfers[completed % AR_TRANSFER_SLOT_COUNT];
+
+    if (completed > g.uploadReclaimed && pTransfer->value == completed)
+    {
+        g.stagingTail = pTransfer->stagingEnd;
+        g.uploadReclaimed = completed;
+    }
+}
+
+internal VkDeviceSize
+arStagingAlloc(
+    VkDeviceSize size)
+{
+    size = (size + AR_STAGING_ALIGNMENT - 1) & ~(VkDeviceSize)(AR_STAGING_ALIGNMENT - 1);
+
+    for (;;)
+    {
+        arStagingReclaim();
+
+        VkDeviceSize offset = g.stagingHead;
+
+        // Head and tail only meet when the ring is empty, so the wrapping cases keep one byte of slack.
+        if (g.stagingHead >= g.stagingTail)
+        {
+            if (size <= AR_STAGING_SIZE - g.stagingHead)
+            {
+                g.stagingHead += size;
+                return(offset);
+            }
+
+            if (size < g.stagingTail)
+            {
+                g.stagingHead = size;
+                return(0);
+            }
+        }
+        else if (size < g.stagingTail - g.stagingHead)
+        {
+            g.stagingHead += size;
+            return(offset);
+        }
+
+        // Everything still held belongs to the open transfer, so submit it to let the ring drain.
+        if (g.uploadReclaimed == g.uploadCounter)
+        {
+            arEndTransfer();
+            arBeginTransfer();
+            continue;
+        }
+
+        if (g.dedicatedTransfer)
+        {
+            arFlushAcquires(g.uploadReclaimed + 1);
+            arWaitTimeline(g.acquireTimeline, g.uploadReclaimed + 1);
+        }
+        else
+        {
+            arWaitTimeline(g.uploadTimeline, g.uploadReclaimed + 1);
+        }
+    }
+}
+
+internal void
+arReleaseToGraphics(
+    VkBufferMemoryBarrier2* pBufferBarrier,
+    VkImageMemoryBarrier2* pImageBarrier)
+{
+    // The barrier describes the whole hand-off. With a dedicated transfer queue it is split into
+    // a release on the transfer queue and a matching acquire on the graphics queue.
+    VkDependencyInfo dependencyInfo;
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = NULL;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.memoryBarrierCount = 0;
+    dependencyInfo.bufferMemoryBarrierCount = pBufferBarrier != NULL;
+    dependencyInfo.pBufferMemoryBarriers = pBufferBarrier;
+    dependencyInfo.imageMemoryBarrierCount = pImageBarrier != NULL;
+    dependencyInfo.pImageMemoryBarriers = pImageBarrier;
+
+    if (!g.dedicatedTransfer)
+    {
+        g.vkCmdPipelineBarrier2(g.pTransfer->cmd, &dependencyInfo);
+        return;
+    }
+
+    VkBufferMemoryBarrier2 bufferBarrier;
+    VkImageMemoryBarrier2 imageBarrier;
+
+    if (pBufferBarrier)
+    {
+        bufferBarrier = *pBufferBarrier;
+        bufferBarrier.srcQueueFamilyIndex = g.transferQueueFamily;
+        bufferBarrier.dstQueueFamilyIndex = g.graphicsQueueFamily;
+        bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        bufferBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+        dependencyInfo.pBufferMemoryBarriers = &bufferBarrier;
+    }
+
+    if (pImageBarrier)
+    {
+        imageBarrier = *pImageBarrier;
+        imageBarrier.srcQueueFamilyIndex = g.transferQueueFamily;
+        imageBarrier.dstQueueFamilyIndex = g.graphicsQueueFamily;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+        dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+    }
+
+    g.vkCmdPipelineBarrier2(g.pTransfer->cmd, &dependencyInfo);
+
+    if (pBufferBarrier)
+    {
+        bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        bufferBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        bufferBarrier.dstStageMask = pBufferBarrier->dstStageMask;
+        bufferBarrier.dstAccessMask = pBufferBarrier->dstAccessMask;
+    }
+
+    if (pImageBarrier)
+    {
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        imageBarrier.dstStageMask = pImageBarrier->dstStageMask;
+        imageBarrier.dstAccessMask = pImageBarrier->dstAccessMask;
+    }
+
+    g.vkCmdPipelineBarrier2(g.pTransfer->acquireCmd, &dependencyInfo);
+}
+
+internal uint64_t
+arEndUpload(void)
+{
+    // Inside a batch the upload completes with the batch, whose transfer is submitted next.
+    if (g.uploadBatch)
+    {
+        return(g.uploadCounter + 1);
+    }
+
+    arEndTransfer();
+    return(g.uploadCounter);
+}
+
+// Required, preferred and avoided property flags for each memory usage.
+global VkMemoryPropertyFlags const arMemoryUsageFlags[AR_MEMORY_USAGE_COUNT][3] =
+{
+    {
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+    },
+    {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+    },
+    {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    },
+    {
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+    },
+    {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        0,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+    }
+};
+
+internal int32_t
+arMemoryTypeScore(
+    uint32_t typeIndex,
+    ArMemoryUsage usage)
+{
+    VkMemoryPropertyFlags flags = g.memoryProperties.memoryTypes[typeIndex].propertyFlags;
+    VkMemoryPropertyFlags preferred = arMemoryUsageFlags[usage][1];
+    VkMemoryPropertyFlags avoided = arMemoryUsageFlags[usage][2];
+    int32_t score = 0;
+
+    // Without resizable BAR the host visible part of VRAM is a small window, uploads stay in system memory.
+    if (usage == AR_MEMORY_USAGE_UPLOAD && !g.resizableBar && !g.unifiedMemory)
+    {
+        preferred &= ~(VkMemoryPropertyFlags)VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        avoided |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    }
+
+    for (VkMemoryPropertyFlags bit = 1; bit; bit <<= 1)
+    {
+        score += (flags & bit & preferred) ? 2 : 0;
+        score -= (flags & bit & avoided) ? 1 : 0;
+    }
+
+    return(score);
+}
+
+internal bool
+arMemoryTypeBefore(
+    uint32_t typeIndex,
+    uint32_t otherIndex,
+    ArMemoryUsage usage)
+{
+    int32_t score = arMemoryTypeScore(typeIndex, usage);
+    int32_t otherScore = arMemoryTypeScore(otherIndex, usage);
+
+    if (score != otherScore)
+    {
+        return(score > otherScore);
+    }
+
+    // Equally suited types are told apart by their heap, a bigger one takes longer to run out.
+    VkMemoryHeap const* pHeaps = g.memoryProperties.memoryHeaps;
+    VkDeviceSize heapSize = pHeaps[g.memoryProperties.memoryTypes[typeIndex].heapIndex].size;
+    VkDeviceSize otherHeapSize = pHeaps[g.memoryProperties.memoryTypes[otherIndex].heapIndex].size;
+
+    if (heapSize != otherHeapSize)
+    {
+        return(heapSize > otherHeapSize);
+    }
+
+    return(typeIndex < otherIndex);
+}
+
+internal void
+arMemoryTypesCreate(void)
+{
+    g.vkGetPhysicalDeviceMemoryProperties(g.gpu, &g.memoryProperties);
+
+    g.unifiedMemory = true;
+
+    for (uint32_t i = g.memoryProperties.memoryHeapCount; i--; )
+    {
+        g.unifiedMemory &= (g.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    g.resizableBar = false;
+
+    for (uint32_t i = g.memoryProperties.memoryTypeCount; i--; )
+    {
+        VkMemoryType type = g.memoryProperties.memoryTypes[i];
+        VkMemoryPropertyFlags barFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+        if ((type.propertyFlags & barFlags) == barFlags && g.memoryProperties.memoryHeaps[type.heapIndex].size > AR_MEMORY_BAR_SIZE)
+        {
+            g.resizableBar = !g.unifiedMemory;
+        }
+    }
+
+    // Every usage gets its candidates ranked once, allocations take the first one the resource accepts.
+    for (uint32_t usage = AR_MEMORY_USAGE_COUNT; usage--; )
+    {
+        uint32_t* pOrder = g.memoryTypeOrder[usage];
+        uint32_t count = 0;
+
+        for (uint32_t typeIndex = 0; typeIndex < g.memoryProperties.memoryTypeCount; ++typeIndex)
+        {
+            VkMemoryPropertyFlags flags = g.memoryProperties.memoryTypes[typeIndex].propertyFlags;
+
+            // Protected and device coherent memory need features that are never enabled.
+            if ((flags & arMemoryUsageFlags[usage][0]) != arMemoryUsageFlags[usage][0] ||
+                (flags & (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD | VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD)))
+            {
+                continue;
+            }
+
+            uint32_t position = count++;
+
+            for ( ; position && arMemoryTypeBefore(typeIndex, pOrder[position - 1], (ArMemoryUsage)usage); --position)
+            {
+                pOrder[position] = pOrder[position - 1];
+            }
+
+            pOrder[position] = typeIndex;
+        }
+
+        g.memoryTypeOrderCount[usage] = count;
+    }
+}
+
+internal uint32_t
+arFindMemoryType(
+    uint32_t typeBitsRequirement,
+    ArMemoryUsage usage)
+{
+    for (uint32_t i = 0; i < g.memoryTypeOrderCount[usage]; ++i)
+    {
+        if (typeBitsRequirement & (1u << g.memoryTypeOrder[usage][i]))
+        {
+            return(g.memoryTypeOrder[usage][i]);
+        }
+    }
+
+    return(UINT32_MAX);
+}
+
+internal void*
+arHostAlloc(
+    size_t size)
+{
+#if defined(AR_PLATFORM_WIN32)
+    void* pMemory = HeapAlloc(GetProcessHeap(), 0, size);
+#elif defined(AR_PLATFORM_POSIX)
+    void* pMemory = malloc(size);
+#endif
+
+    if (!pMemory)
+    {
+        arError("Failed to allocate memory");
+    }
+
+    return(pMemory);
+}
+
+internal void
+arHostFree(
+    void* pMemory)
+{
+#if defined(AR_PLATFORM_WIN32)
+    HeapFree(GetProcessHeap(), 0, pMemory);
+#elif defined(AR_PLATFORM_POSIX)
+    free(pMemory);
+#endif
+}
+
+internal uint32_t
+arFindFirstSet(
+    uint32_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return((uint32_t)index);
+#else
+    return((uint32_t)__builtin_ctz(value));
+#endif
+}
+
+internal uint32_t
+arFindLastSet(
+    uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return((uint32_t)index);
+#else
+    return(63 - (uint32_t)__builtin_clzll(value));
+#endif
+}
+
+internal void
+arTlsfMapping(
+    VkDeviceSize size,
+    uint32_t* pFl,
+    uint32_t* pSl)
+{
+    VkDeviceSize units = size / AR_MEMORY_MIN_ALIGNMENT;
+    uint32_t fl = arFindLastSet(units);
+
+    if (fl < AR_TLSF_SL_LOG2)
+    {
+        *pFl = 0;
+        *pSl = (uint32_t)units;
+    }
+    else
+    {
+        *pFl = fl - AR_TLSF_SL_LOG2 + 1;
+        *pSl = (uint32_t)(units >> (fl - AR_TLSF_SL_LOG2)) - AR_TLSF_SL_COUNT;
+    }
+}
+
+internal void
+arTlsfInsert(
+    ArMemoryPool* pPool,
+    ArAllocation* pNode)
+{
+    uint32_t fl, sl;
+    arTlsfMapping(pNode->size, &fl, &sl);
+
+    pNode->isFree = true;
+    pNode->pPrevFree = NULL;
+    pNode->pNextFree = pPool->pFree[fl][sl];
+
+    if (pNode->pNextFree)
+    {
+        pNode->pNextFree->pPrevFree = pNode;
+    }
+
+    pPool->pFree[fl][sl] = pNode;
+    pPool->flBitmap |= 1u << fl;
+    pPool->slBitmap[fl] |= 1u << sl;
+}
+
+internal void
+arTlsfRemove(
+    ArMemoryPool* pPool,
+    ArAllocation* pNode)
+{
+    uint32_t fl, sl;
+    arTlsfMapping(pNode->size, &fl, &sl);
+
+    if (pNode->pPrevFree)
+    {
+        pNode->pPrevFree->pNextFree = pNode->pNextFree;
+    }
+    else
+    {
+        pPool->pFree[fl][sl] = pNode->pNextFree;
+    }
+
+    if (pNode->pNextFree)
+    {
+        pNode->pNextFree->pPrevFree = pNode->pPrevFree;
+    }
+
+    if (!pPool->pFree[fl][sl])
+    {
+        pPool->slBitmap[fl] &= ~(1u << sl);
+
+        if (!pPool->slBitmap[fl])
+        {
+            pPool->flBitmap &= ~(1u << fl);
+        }
+    }
+
+    pNode->isFree = false;
+}
+
+internal ArAllocation*
+arTlsfFind(
+    ArMemoryPool* pPool,
+    VkDeviceSize size)
+{
+    uint32_t fl, sl;
+
+    // Round up to the next list so every node found is large enough.
+    VkDeviceSize units = size / AR_MEMORY_MIN_ALIGNMENT;
+    uint32_t msb = arFindLastSet(units);
+
+    if (msb >= AR_TLSF_SL_LOG2)
+    {
+        units += ((VkDeviceSize)1 << (msb - AR_TLSF_SL_LOG2)) - 1;
+    }
+
+    arTlsfMapping(units * AR_MEMORY_MIN_ALIGNMENT, &fl, &sl);
+
+    if (fl >= AR_TLSF_FL_COUNT)
+    {
+        return(NULL);
+    }
+
+    uint32_t slMap = pPool->slBitmap[fl] & (~0u << sl);
+
+    if (!slMap)
+    {
+        uint32_t flMap = fl + 1 < AR_TLSF_FL_COUNT ? pPool->flBitmap & (~0u << (fl + 1)) : 0;
+
+        if (!flMap)
+        {
+            return(NULL);
+        }
+
+        fl = arFindFirstSet(flMap);
+        slMap = pPool->slBitmap[fl];
+    }
+
+    return(pPool->pFree[fl][arFindFirstSet(slMap)]);
+}
+
+internal ArMemoryBlock*
+arMemoryBlockCreate(
+    ArMemoryPool* pPool,
+    VkDeviceSize size,
+    VkDeviceSize minSize,
+    VkMemoryDedicatedAllocateInfo const* pDedicatedAllocateInfo)
+{
+    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo;
+    memoryAllocateFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+    memoryAllocateFlagsInfo.pNext = pDedicatedAllocateInfo;
+    memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+    memoryAllocateFlagsInfo.deviceMask = 0;
+
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
+    memoryAllocateInfo.memoryTypeIndex = pPool->memoryTypeIndex;
+    memoryAllocateInfo.allocationSize = size;
+
+    VkDeviceMemory memory;
+    VkResult result;
+
+    // Fall back to smaller blocks when the heap is too fragmented for a full one.
+    while ((result = g.vkAllocateMemory(g.device, &memoryAllocateInfo, NULL, &memory)) != VK_SUCCESS &&
+           memoryAllocateInfo.allocationSize / 2 >= minSize)
+    {
+        memoryAllocateInfo.allocationSize /= 2;
+    }
+
+    arVkCheck(result);
+
+    ArMemoryBlock* pBlock = arHostAlloc(sizeof(ArMemoryBlock));
+    pBlock->pPool = pPool;
+    pBlock->pNext = NULL;
+    pBlock->memory = memory;
+    pBlock->size = memoryAllocateInfo.allocationSize;
+    pBlock->pMapped = NULL;
+    pBlock->allocationCount = 0;
+    pBlock->isDedicated = pDedicatedAllocateInfo != NULL;
+
+    g.heapBlockBytes[g.memoryProperties.memoryTypes[pPool->memoryTypeIndex].heapIndex] += pBlock->size;
+    g.blockCount += 1;
+    g.dedicatedBlockCount += pBlock->isDedicated;
+
+    if (!pBlock->isDedicated)
+    {
+        pBlock->pNext = pPool->pBlocks;
+        pPool->pBlocks = pBlock;
+    }
+
+    // Host visible blocks stay mapped for their whole lifetime, a memory object can only be mapped once.
+    if (g.memoryProperties.memoryTypes[pPool->memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        arVkCheck(g.vkMapMemory(g.device, memory, 0, VK_WHOLE_SIZE, 0, &pBlock->pMapped));
+    }
+
+    return(pBlock);
+}
+
+internal void
+arMemoryBlockDestroy(
+    ArMemoryBlock* pBlock)
+{
+    if (!pBlock->isDedicated)
+    {
+        ArMemoryBlock** ppLink = &pBlock->pPool->pBlocks;
+
+        while (*ppLink != pBlock)
+        {
+            ppLink = &(*ppLink)->pNext;
+        }
+
+        *ppLink = pBlock->pNext;
+    }
+
+    g.heapBlockBytes[g.memoryProperties.memoryTypes[pBlock->pPool->memoryTypeIndex].heapIndex] -= pBlock->size;
+    g.blockCount -= 1;
+    g.dedicatedBlockCount -= pBlock->isDedicated;
+
+    g.vkFreeMemory(g.device, pBlock->memory, NULL);
+    arHostFree(pBlock);
+}
+
+internal void
+arMemoryTrack(
+    ArAllocation const* pNode,
+    bool isAllocated)
+{
+    uint32_t heapIndex = g.memoryProperties.memoryTypes[pNode->pBlock->pPool->memoryTypeIndex].heapIndex;
+
+    if (isAllocated)
+    {
+        g.heapAllocationBytes[heapIndex] += pNode->size;
+        g.categoryBytes[pNode->category] += pNode->size;
+        g.allocationCount += 1;
+    }
+    else
+    {
+        g.heapAllocationBytes[heapIndex] -= pNode->size;
+        g.categoryBytes[pNode->category] -= pNode->size;
+        g.allocationCount -= 1;
+    }
+}
+
+internal ArAllocation*
+arAllocMemory(
+    VkMemoryRequirements const* pRequirements,
+    uint32_t typeIndex,
+    ArMemoryCategory category,
+    bool isLinear,
+    VkBuffer buffer,
+    VkImage image)
+{
+    ArMemoryPool* pPool = &g.memoryPools[typeIndex][isLinear ? 0 : 1];
+    pPool->memoryTypeIndex = typeIndex;
+
+    VkDeviceSize heapSize = g.memoryProperties.memoryHeaps[g.memoryProperties.memoryTypes[typeIndex].heapIndex].size;
+    VkDeviceSize blockSize = heapSize >= ((VkDeviceSize)4 << 30) ? AR_MEMORY_LARGE_BLOCK_SIZE : AR_MEMORY_BLOCK_SIZE;
+    blockSize = min(blockSize, heapSize / 8);
+
+    VkDeviceSize alignment = max(pRequirements->alignment, AR_MEMORY_MIN_ALIGNMENT);
+    VkDeviceSize size = (pRequirements->size + AR_MEMORY_MIN_ALIGNMENT - 1) & ~(VkDeviceSize)(AR_MEMORY_MIN_ALIGNMENT - 1);
+
+    ArAllocation* pNode = arHostAlloc(sizeof(ArAllocation));
+
+    // Resources that would take up a large part of a block get their own memory object.
+    if (size >= blockSize / 2)
+    {
+        VkMemoryDedicatedAllocateInfo dedicatedAllocateInfo;
+        dedicatedAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedAllocateInfo.pNext = NULL;
+        dedicatedAllocateInfo.image = image;
+        dedicatedAllocateInfo.buffer = buffer;
+
+        // Memory dedicated to a resource has to match its requirements exactly, without the rounding.
+        VkDeviceSize dedicatedSize = (buffer || image) ? pRequirements->size : size;
+
+        pNode->pBlock = arMemoryBlockCreate(pPool, dedicatedSize, dedicatedSize, &dedicatedAllocateInfo);
+        pNode->pBlock->allocationCount = 1;
+        pNode->pPrevPhysical = NULL;
+        pNode->pNextPhysical = NULL;
+        pNode->pPrevFree = NULL;
+        pNode->pNextFree = NULL;
+        pNode->offset = 0;
+        pNode->size = pNode->pBlock->size;
+        pNode->category = category;
+        pNode->isFree = false;
+
+        arMemoryTrack(pNode, true);
+        return(pNode);
+    }
+
+    VkDeviceSize searchSize = size + alignment - AR_MEMORY_MIN_ALIGNMENT;
+    ArAllocation* pFree = arTlsfFind(pPool, searchSize);
+
+    if (!pFree)
+    {
+        ArMemoryBlock* pBlock = arMemoryBlockCreate(pPool, max(blockSize, searchSize), searchSize, NULL);
+
+        pFree = arHostAlloc(sizeof(ArAllocation));
+        pFree->pBlock = pBlock;
+        pFree->pPrevPhysical = NULL;
+        pFree->pNextPhysical = NULL;
+        pFree->offset = 0;
+        pFree->size = pBlock->size;
+        arTlsfInsert(pPool, pFree);
+    }
+
+    arTlsfRemove(pPool, pFree);
+
+    VkDeviceSize offset = (pFree->offset + alignment - 1) & ~(alignment - 1);
+
+    if (offset != pFree->offset)
+    {
+        // Leading padding stays behind as a free node, its previous neighbour is never free.
+        pNode->pBlock = pFree->pBlock;
+        pNode->pPrevPhysical = pFree;
+        pNode->pNextPhysical = pFree->pNextPhysical;
+        pNode->offset = offset;
+        pNode->size = pFree->size - (offset - pFree->offset);
+
+        if (pNode->pNextPhysical)
+        {
+            pNode->pNextPhysical->pPrevPhysical = pNode;
+        }
+
+        pFree->pNextPhysical = pNode;
+        pFree->size = offset - pFree->offset;
+        arTlsfInsert(pPool, pFree);
+    }
+    else
+    {
+        arHostFree(pNode);
+        pNode = pFree;
+    }
+
+    if (pNode->size - size >= AR_MEMORY_MIN_ALIGNMENT)
+    {
+        ArAllocation* pTail = arHostAlloc(sizeof(ArAllocation));
+        pTail->pBlock = pNode->pBlock;
+        pTail->pPrevPhysical = pNode;
+        pTail->pNextPhysical = pNode->pNextPhysical;
+        pTail->offset = pNode->offset + size;
+        pTail->size = pNode->size - size;
+
+        if (pTail->pNextPhysical)
+        {
+            pTail->pNextPhysical->pPrevPhysical = pTail;
+        }
+
+        pNode->pNextPhysical = pTail;
+        pNode->size = size;
+        arTlsfInsert(pPool, pTail);
+    }
+
+    pNode->category = category;
+    pNode->isFree = false;
+    pNode->pBlock->allocationCount += 1;
+
+    arMemoryTrack(pNode, true);
+    return(pNode);
+}
+
+internal void
+arFreeMemory(
+    ArAllocation* pNode)
+{
+    ArMemoryBlock* pBlock = pNode->pBlock;
+    ArMemoryPool* pPool = pBlock->pPool;
+    pBlock->allocationCount -= 1;
+    arMemoryTrack(pNode, false);
+
+    if (pBlock->isDedicated)
+    {
+        arMemoryBlockDestroy(pBlock);
+        arHostFree(pNode);
+        return;
+    }
+
+    ArAllocation* pPrev = pNode->pPrevPhysical;
+    ArAllocation* pNext = pNode->pNextPhysical;
+
+    if (pPrev && pPrev->isFree)
+    {
+        arTlsfRemove(pPool, pPrev);
+        pPrev->size += pNode->size;
+        pPrev->pNextPhysical = pNext;
+
+        if (pNext)
+        {
+            pNext->pPrevPhysical = pPrev;
+        }
+
+        arHostFree(pNode);
+        pNode = pPrev;
+    }
+
+    if (pNext && pNext->isFree)
+    {
+        arTlsfRemove(pPool, pNext);
+        pNode->size += pNext->size;
+        pNode->pNextPhysical = pNext->pNextPhysical;
+
+        if (pNode->pNextPhysical)
+        {
+            pNode->pNextPhysical->pPrevPhysical = pNode;
+        }
+
+        arHostFree(pNext);
+    }
+
+    // Empty blocks go back to the driver, except the last one of a pool which is likely to be reused.
+    if (!pBlock->allocationCount && (pPool->pBlocks != pBlock || pBlock->pNext))
+    {
+        arMemoryBlockDestroy(pBlock);
+        arHostFree(pNode);
+        return;
+    }
+
+    arTlsfInsert(pPool, pNode);
+}
+
+internal void
+arMemoryTeardown(void)
+{
+    for (uint32_t i = VK_MAX_MEMORY_TYPES; i--; )
+    {
+        for (uint32_t j = 2; j--; )
+        {
+            ArMemoryPool* pPool = &g.memoryPools[i][j];
+
+            for (uint32_t fl = AR_TLSF_FL_COUNT; fl--; )
+            {
+                for (uint32_t sl = AR_TLSF_SL_COUNT; sl--; )
+                {
+                    while (pPool->pFree[fl][sl])
+                    {
+                        ArAllocation* pFree = pPool->pFree[fl][sl];
+                        pPool->pFree[fl][sl] = pFree->pNextFree;
+                        arHostFree(pFree);
+                    }
+                }
+
+                pPool->slBitmap[fl] = 0;
+            }
+
+            pPool->flBitmap = 0;
+
+            while (pPool->pBlocks)
+            {
+                arMemoryBlockDestroy(pPool->pBlocks);
+            }
+        }
+    }
+}
+
+internal void
+arDeferDestroy(
+    ArDeferredDestroy* pEntry)
+{
+    // The frame being built may still replay commands recorded before the handle was dropped,
+    // and an upload into it may still be running on the transfer queue.
+    pEntry->frame = g.frameCounter + 1;
+    pEntry->upload = g.uploadBatch ? g.uploadCounter + 1 : g.uploadCounter;
+
+    if (g.deferredCount == g.deferredCapacity)
+    {
+        uint32_t capacity = g.deferredCapacity ? g.deferredCapacity * 2 : 64;
+        ArDeferredDestroy* pDeferred = arHostAlloc(capacity * sizeof(ArDeferredDestroy));
+
+        if (g.pDeferred)
+        {
+            memcpy(pDeferred, g.pDeferred, g.deferredCount * sizeof(ArDeferredDestroy));
+            arHostFree(g.pDeferred);
+        }
+
+        g.pDeferred = pDeferred;
+        g.deferredCapacity = capacity;
+    }
+
+    g.pDeferred[g.deferredCount++] = *pEntry;
+}
+
+internal void
+arDeferredCollect(
+    uint64_t completedFrame,
+    uint64_t completedUpload)
+{
+    // Entries are queued in submission order, so the completed ones form a prefix.
+    uint32_t count = 0;
+
+    for ( ; count < g.deferredCount; ++count)
+    {
+        ArDeferredDestroy* pEntry = &g.pDeferred[count];
+
+        if (pEntry->frame > completedFrame || pEntry->upload > completedUpload)
+        {
+            break;
+        }
+
+        if (pEntry->pipeline)
+        {
+            g.vkDestroyPipeline(g.device, pEntry->pipeline, NULL);
+        }
+
+        if (pEntry->view)
+        {
+            g.vkDestroyImageView(g.device, pEntry->view, NULL);
+        }
+
+        if (pEntry->image)
+        {
+            g.vkDestroyImage(g.device, pEntry->image, NULL);
+        }
+
+        if (pEntry->buffer)
+        {
+            g.vkDestroyBuffer(g.device, pEntry->buffer, NULL);
+        }
+
+        if (pEntry->pAllocation)
+        {
+            if (pEntry->image)
+            {
+                arReleaseImageMemory(pEntry->pAllocation);
+            }
+            else
+            {
+                arFreeMemory(pEntry->pAllocation);
+            }
+        }
+    }
+
+    if (count)
+    {
+        g.deferredCount -= count;
+        memmove(g.pDeferred, g.pDeferred + count, g.deferredCount * sizeof(ArDeferredDestroy));
+    }
+}
+
+internal void
+arAllocBuffer(
+    ArBuffer* pBuffer,
+    ArMemoryCategory category,
+    ArMemoryUsage usage)
+{
+    const VkBufferUsageFlags bufferUsage =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    VkBufferCreateInfo bufferCreateInfo;
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = NULL;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.size = pBuffer->size;
+    bufferCreateInfo.usage = bufferUsage;
+
+    // Staging memory is copied from on both queues, without ownership transfers.
+    uint32_t const queueFamilies[2] = { g.transferQueueFamily, g.graphicsQueueFamily };
+
+    if (category == AR_MEMORY_CATEGORY_STAGING && g.dedicatedTransfer)
+    {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferCreateInfo.queueFamilyIndexCount = 2;
+        bufferCreateInfo.pQueueFamilyIndices = queueFamilies;
+    }
+
+    arVkCheck(g.vkCreateBuffer(g.device, &bufferCreateInfo, NULL, (VkBuffer*)&pBuffer->handle.data[0]));
+
+    VkMemoryRequirements memoryRequirements;
+    g.vkGetBufferMemoryRequirements(g.device, pBuffer->handle.data[0], &memoryRequirements);
+
+    uint32_t typeIndex = arFindMemoryType(memoryRequirements.memoryTypeBits, usage);
+
+    if (typeIndex == UINT32_MAX)
+    {
+        arVkCheck(VK_ERROR_INITIALIZATION_FAILED);
+    }
+
+    ArAllocation* pAllocation = arAllocMemory(&memoryRequirements, typeIndex, category, true, pBuffer->handle.data[0], NULL);
+    pBuffer->handle.data[1] = pAllocation;
+    arVkCheck(g.vkBindBufferMemory(g.device, pBuffer->handle.data[0], pAllocation->pBlock->memory, pAllocation->offset));
+
+    VkBufferDeviceAddressInfo addressInfo;
+    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    addressInfo.pNext = NULL;
+    addressInfo.buffer = pBuffer->handle.data[0];
+    pBuffer->address = g.vkGetBufferDeviceAddress(g.device, &addressInfo);
+}
+
+internal void
+arCreateMappedBuffer(
+    ArBuffer* pBuffer,
+    uint64_t capacity,
+    ArMemoryCategory category,
+    ArMemoryUsage usage)
+{
+    pBuffer->size = capacity;
+    arAllocBuffer(pBuffer, category, usage);
+
+    ArAllocation* pAllocation = pBuffer->handle.data[1];
+    pBuffer->pMapped = (char*)pAllocation->pBlock->pMapped + pAllocation->offset;
+}
+
+void
+arCreateDynamicBuffer(
+    ArBuffer* pBuffer,
+    uint64_t capacity)
+{
+    arCreateMappedBuffer(pBuffer, capacity, AR_MEMORY_CATEGORY_DYNAMIC_BUFFER, AR_MEMORY_USAGE_UPLOAD);
+}
+
+void
+arCreateStaticBuffer(
+    ArBuffer* pBuffer,
+    uint64_t size,
+    void const* pData)
+{
+    pBuffer->size = size;
+    arAllocBuffer(pBuffer, AR_MEMORY_CATEGORY_STATIC_BUFFER, AR_MEMORY_USAGE_DEVICE);
+
+    if (pData)
+    {
+        arFlushAcquires(arUploadBufferAsync(pBuffer, 0, size, pData));
+    }
+}
+
+void
+arUpdateBuffer(
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    uint64_t size,
+    void const* pData)
+{
+    if (offset > pBuffer->size || size > pBuffer->size - offset)
+    {
+        arError("Buffer update out of range");
+    }
+
+    ArAllocation* pAllocation = pBuffer->handle.data[1];
+    VkMemoryPropertyFlags flags = g.memoryProperties.memoryTypes[pAllocation->pBlock->pPool->memoryTypeIndex].propertyFlags;
+    VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    // Host visible memory is written in place once no frame in flight can read it anymore,
+    // the next submit makes the writes visible to the device.
+    if ((flags & hostFlags) == hostFlags && arGetCompletedFrame() >= g.frameCounter)
+    {
+        memcpy((char*)pAllocation->pBlock->pMapped + pAllocation->offset + offset, pData, size);
+        return;
+    }
+
+    if (!size)
+    {
+        return;
+    }
+
+    if (!g.uploadBatch)
+    {
+        arBeginTransfer();
+    }
+
+    // Otherwise the copy is staged and, like a resize, recorded for the graphics queue. The buffer stays
+    // owned by the graphics family and the copy runs behind the frames that may still read the old contents.
+    VkMemoryBarrier2 memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+    VkDependencyInfo dependencyInfo;
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = NULL;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    dependencyInfo.bufferMemoryBarrierCount = 0;
+    dependencyInfo.imageMemoryBarrierCount = 0;
+    g.vkCmdPipelineBarrier2(g.dedicatedTransfer ? g.pTransfer->acquireCmd : g.pTransfer->cmd, &dependencyInfo);
+
+    // The ring may submit in between, so the command buffer is looked up again for every chunk.
+    for (uint64_t done = 0; done < size; )
+    {
+        VkDeviceSize const chunkSize = min(size - done, AR_STAGING_CHUNK_SIZE);
+        VkDeviceSize const stagingOffset = arStagingAlloc(chunkSize);
+        memcpy((char*)g.stagingBuffer.pMapped + stagingOffset, (char const*)pData + done, chunkSize);
+
+        VkBufferCopy region;
+        region.srcOffset = stagingOffset;
+        region.dstOffset = offset + done;
+        region.size = chunkSize;
+
+        g.vkCmdCopyBuffer(
+            g.dedicatedTransfer ? g.pTransfer->acquireCmd : g.pTransfer->cmd,
+            g.stagingBuffer.handle.data[0],
+            pBuffer->handle.data[0],
+            1,
+            &region);
+
+        done += chunkSize;
+    }
+
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+    g.vkCmdPipelineBarrier2(g.dedicatedTransfer ? g.pTransfer->acquireCmd : g.pTransfer->cmd, &dependencyInfo);
+
+    arFlushAcquires(arEndUpload());
+}
+
+uint64_t
+arResizeBuffer(
+    ArBuffer* pBuffer,
+    uint64_t size)
+{
+    if (g.uploadBatch)
+    {
+        arError("Buffers can't be resized inside an upload batch");
+    }
+
+    ArBuffer oldBuffer = *pBuffer;
+    ArMemoryCategory category = ((ArAllocation*)oldBuffer.handle.data[1])->category;
+    uint64_t copySize = min(oldBuffer.size, size);
+
+    // Mapped buffers are copied by the host, so their new mapping is valid as soon as this returns.
+    if (category == AR_MEMORY_CATEGORY_DYNAMIC_BUFFER)
+    {
+        arCreateMappedBuffer(pBuffer, size, category, AR_MEMORY_USAGE_UPLOAD);
+        memcpy(pBuffer->pMapped, oldBuffer.pMapped, copySize);
+        arDestroyBufferDeferred(&oldBuffer);
+        return(pBuffer->address);
+    }
+
+    pBuffer->size = size;
+    arAllocBuffer(pBuffer, category, AR_MEMORY_USAGE_DEVICE);
+
+    // The copy is recorded for the graphics queue, behind every frame that may have written the old buffer
+    // and behind the acquires of uploads into it.
+    arBeginTransfer();
+    VkCommandBuffer cmd = g.dedicatedTransfer ? g.pTransfer->acquireCmd : g.pTransfer->cmd;
+
+    VkMemoryBarrier2 memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+
+    VkDependencyInfo dependencyInfo;
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = NULL;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    dependencyInfo.bufferMemoryBarrierCount = 0;
+    dependencyInfo.imageMemoryBarrierCount = 0;
+    g.vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    if (copySize)
+    {
+        VkBufferCopy region;
+        region.srcOffset = 0;
+        region.dstOffset = 0;
+        region.size = copySize;
+        g.vkCmdCopyBuffer(cmd, oldBuffer.handle.data[0], pBuffer->handle.data[0], 1, &region);
+    }
+
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+    g.vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    // Flushed right away, so the next frame's timeline value also covers the copy and the old buffer
+    // is released with it.
+    arFlushAcquires(arEndUpload());
+    arDestroyBufferDeferred(&oldBuffer);
+
+    return(pBuffer->address);
+}
+
+uint64_t
+arUploadBufferAsync(
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    uint64_t size,
+    void const* pData)
+{
+    if (!size)
+    {
+        return(g.uploadCounter);
+    }
+
+    if (!g.uploadBatch)
+    {
+        arBeginTransfer();
+    }
+
+    // Uploads larger than a chunk are copied piecewise, so the ring can submit and recycle in between.
+    for (uint64_t done = 0; done < size; )
+    {
+        VkDeviceSize const chunkSize = min(size - done, AR_STAGING_CHUNK_SIZE);
+        VkDeviceSize const stagingOffset = arStagingAlloc(chunkSize);
+        memcpy((char*)g.stagingBuffer.pMapped + stagingOffset, (char const*)pData + done, chunkSize);
+
+        VkBufferCopy region;
+        region.srcOffset = stagingOffset;
+        region.dstOffset = offset + done;
+        region.size = chunkSize;
+
+        g.vkCmdCopyBuffer(
+            g.pTransfer->cmd,
+            g.stagingBuffer.handle.data[0],
+            pBuffer->handle.data[0],
+            1,
+            &region);
+
+        done += chunkSize;
+    }
+
+    VkBufferMemoryBarrier2 bufferMemoryBarrier;
+    bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    bufferMemoryBarrier.pNext = NULL;
+    bufferMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    bufferMemoryBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    bufferMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    bufferMemoryBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+    bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferMemoryBarrier.buffer = pBuffer->handle.data[0];
+    bufferMemoryBarrier.offset = offset;
+    bufferMemoryBarrier.size = size;
+    arReleaseToGraphics(&bufferMemoryBarrier, NULL);
+
+    return(arEndUpload());
+}
+
+void
+arDestroyBuffer(
+    ArBuffer const* pBuffer)
+{
+    g.vkDestroyBuffer(g.device, pBuffer->handle.data[0], NULL);
+    arFreeMemory(pBuffer->handle.data[1]);
+}
+
+void
+arDestroyBufferDeferred(
+    ArBuffer const* pBuffer)
+{
+    ArDeferredDestroy entry;
+    entry.buffer = pBuffer->handle.data[0];
+    entry.image = NULL;
+    entry.view = NULL;
+    entry.pipeline = NULL;
+    entry.pAllocation = pBuffer->handle.data[1];
+    arDeferDestroy(&entry);
+}
+
+internal ArAllocation*
+arTransientAcquire(
+    uint32_t slot,
+    VkMemoryRequirements const* pRequirements)
+{
+    ArTransientSlot* pSlot = &g.transientSlots[slot];
+    ArAllocation* pAllocation = pSlot->pAllocation;
+
+    if (pAllocation &&
+        pAllocation->size >= pRequirements->size &&
+        pAllocation->offset % pRequirements->alignment == 0 &&
+        (pRequirements->memoryTypeBits & (1u << pAllocation->pBlock->pPool->memoryTypeIndex)))
+    {
+        pSlot->refCount += 1;
+        return(pAllocation);
+    }
+
+    // Only one generation of memory can wait for its images, after that new images get memory of their own.
+    if (pSlot->refCount && pSlot->pRetiredAllocation)
+    {
+        return(NULL);
+    }
+
+    uint32_t typeIndex = arFindMemoryType(pRequirements->memoryTypeBits, AR_MEMORY_USAGE_TRANSIENT);
+
+    if (typeIndex == UINT32_MAX)
+    {
+        return(NULL);
+    }
+
+    if (pSlot->refCount)
+    {
+        pSlot->pRetiredAllocation = pAllocation;
+        pSlot->retiredRefCount = pSlot->refCount;
+    }
+    else if (pAllocation)
+    {
+        arFreeMemory(pAllocation);
+    }
+
+    // Never a dedicated allocation, other images of the slot are bound to it as well.
+    pSlot->pAllocation = arAllocMemory(pRequirements, typeIndex, AR_MEMORY_CATEGORY_IMAGE, false, NULL, NULL);
+    pSlot->refCount = 1;
+
+    return(pSlot->pAllocation);
+}
+
+internal void
+arReleaseImageMemory(
+    ArAllocation* pAllocation)
+{
+    for (uint32_t i = AR_MAX_TRANSIENT_SLOTS; i--; )
+    {
+        ArTransientSlot* pSlot = &g.transientSlots[i];
+
+        if (pSlot->pAllocation == pAllocation && pSlot->refCount)
+        {
+            pSlot->refCount -= 1;
+            return;
+        }
+
+        if (pSlot->pRetiredAllocation == pAllocation && pSlot->retiredRefCount)
+        {
+            if (--pSlot->retiredRefCount == 0)
+            {
+                arFreeMemory(pAllocation);
+                pSlot->pRetiredAllocation = NULL;
+            }
+
+            return;
+        }
+    }
+
+    arFreeMemory(pAllocation);
+}
+
+internal void
+arImageCreate(
+    ArImage* pImage,
+    ArImageCreateInfo const* pImageCreateInfo,
+    uint32_t aliasSlot,
+    VkImageUsageFlags extraUsage)
+{
+    VkImageAspectFlags aspect = 0;
+    VkImageUsageFlags usage = extraUsage;
+    VkFormat format = 0;
+
+    switch (pImageCreateInfo->usage)
+    {
+    case AR_IMAGE_USAGE_COLOR_ATTACHMENT:
+        usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        format = VK_FORMAT_B8G8R8A8_UNORM;
+        break;
+    case AR_IMAGE_USAGE_DEPTH_ATTACHMENT:
+        usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        format = VK_FORMAT_D32_SFLOAT;
+        break;
+    case AR_IMAGE_USAGE_TEXTURE:
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        format = (VkFormat)pImageCreateInfo->format;
+        break;
+    }
+
+    if (pImageCreateInfo->sampler)
+    {
+        usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
+    else if (aliasSlot != UINT32_MAX && pImageCreateInfo->usage != AR_IMAGE_USAGE_TEXTURE)
+    {
+        // Attachments that are never read afterwards can live in lazily allocated memory.
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+
+    if (!pImageCreateInfo->depth)
+    {
+        pImage->depth = 1;
+    }
+    else
+    {
+        pImage->depth = pImageCreateInfo->depth;
+    }
+
+    if (pImageCreateInfo->width && pImageCreateInfo->height)
+    {
+        pImage->width  = pImageCreateInfo->width;
+        pImage->height = pImageCreateInfo->height;
+    }
+    else
+    {
+        pImage->width  = g.extent.width;
+        pImage->height = g.extent.height;
+    }
+
+    VkImageCreateInfo imageCreateInfo;
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.pNext = NULL;
+    imageCreateInfo.flags = 0;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = format;
+    imageCreateInfo.extent.width = pImage->width;
+    imageCreateInfo.extent.height = pImage->height;
+    imageCreateInfo.extent.depth = pImage->depth;
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = usage;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.queueFamilyIndexCount = 0;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    arVkCheck(g.vkCreateImage(g.device, &imageCreateInfo, NULL, (VkImage*)&pImage->handle.data[0]));
+
+    VkMemoryRequirements memoryRequirements;
+    g.vkGetImageMemoryRequirements(g.device, pImage->handle.data[0], &memoryRequirements);
+
+    ArAllocation* pAllocation = aliasSlot != UINT32_MAX ? arTransientAcquire(aliasSlot, &memoryRequirements) : NULL;
+
+    if (!pAllocation)
+    {
+        uint32_t typeIndex = arFindMemoryType(memoryRequirements.memoryTypeBits, AR_MEMORY_USAGE_DEVICE);
+
+        if (typeIndex == UINT32_MAX)
+        {
+            arVkCheck(VK_ERROR_INITIALIZATION_FAILED);
+        }
+
+        pAllocation = arAllocMemory(&memoryRequirements, typeIndex, AR_MEMORY_CATEGORY_IMAGE, false, NULL, pImage->handle.data[0]);
+    }
+
+    pImage->handle.data[1] = pAllocation;
+    arVkCheck(g.vkBindImageMemory(g.device, pImage->handle.data[0], pAllocation->pBlock->memory, pAllocation->offset));
+
+    VkImageViewCreateInfo imageViewCreateInfo;
+    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewCreateInfo.pNext = NULL;
+    imageViewCreateInfo.flags = 0;
+    imageViewCreateInfo.image = pImage->handle.data[0];
+    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCreateInfo.format = format;
+    imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewCreateInfo.subresourceRange.aspectMask = aspect;
+    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+    imageViewCreateInfo.subresourceRange.levelCount = 1;
+    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewCreateInfo.subresourceRange.layerCount = 1;
+    arVkCheck(g.vkCreateImageView(g.device, &imageViewCreateInfo, NULL, (VkImageView*)&pImage->handle.data[2]));
+
+    if (pImageCreateInfo->sampler)
+    {
+        VkDescriptorImageInfo descriptorImageInfo;
+        descriptorImageInfo.sampler = (&g.samplerLinearToEdge)[pImageCreateInfo->sampler - 1];
+        descriptorImageInfo.imageView = pImage->handle.data[2];
+        descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet descriptorWrite;
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.pNext = NULL;
+        descriptorWrite.dstSet = g.descriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = pImageCreateInfo->dstArrayElement;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.pImageInfo = &descriptorImageInfo;
+        descriptorWrite.pBufferInfo = NULL;
+        descriptorWrite.pTexelBufferView = NULL;
+        g.vkUpdateDescriptorSets(g.device, 1, &descriptorWrite, 0, NULL);
+    }
+}
+
+void
+arCreateImage(
+    ArImage* pImage,
+    ArImageCreateInfo const* pImageCreateInfo)
+{
+    arImageCreate(pImage, pImageCreateInfo, UINT32_MAX, 0);
+}
+
+void
+arCreateTransientImage(
+    ArImage* pImage,
+    ArImageCreateInfo const* pImageCreateInfo,
+    uint32_t aliasSlot)
+{
+    if (aliasSlot >= AR_MAX_TRANSIENT_SLOTS)
+    {
+        arError("Transient alias slot out of range");
+    }
+
+    arImageCreate(pImage, pImageCreateInfo, aliasSlot, 0);
+}
+
+void
+arUpdateImage(
+    ArImage* pImage,
+    size_t dataSize,
+    void const* pData)
+{
+    arFlushAcquires(arUploadImageAsync(pImage, dataSize, pData));
+}
+
+uint64_t
+arUploadImageAsync(
+    ArImage const* pImage,
+    size_t dataSize,
+    void const* pData)
+{
+    // Images are split along rows, so only whole rows of a single slice ever share a chunk boundary.
+    uint32_t const rowCount = pImage->height * pImage->depth;
+
+    if (!dataSize || dataSize % rowCount)
+    {
+        arError("Image data size doesn't match the image");
+    }
+
+    VkDeviceSize const rowSize = dataSize / rowCount;
+    uint32_t const chunkRows = (uint32_t)max(AR_STAGING_CHUNK_SIZE / rowSize, 1);
+
+    // The image may be a texture that submitted frames still sample, the submit waits for them.
+    g.transferWaitFrame = g.frameCounter;
+
+    if (!g.uploadBatch)
+    {
+        arBeginTransfer();
+    }
+
+    // The layout transition is chained to the submit's wait, which blocks the transfer stage.
+    VkImageMemoryBarrier2 imageMemoryBarrier;
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    imageMemoryBarrier.pNext = NULL;
+    imageMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+    imageMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.image = pImage->handle.data[0];
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+    VkDependencyInfo dependencyInfo;
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = NULL;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.memoryBarrierCount = 0;
+    dependencyInfo.bufferMemoryBarrierCount = 0;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &imageMemoryBarrier;
+    g.vkCmdPipelineBarrier2(g.pTransfer->cmd, &dependencyInfo);
+
+    for (uint32_t row = 0; row < rowCount; )
+    {
+        uint32_t const y = row % pImage->height;
+        uint32_t const z = row / pImage->height;
+        uint32_t rows = min(chunkRows, pImage->height - y);
+        uint32_t slices = 1;
+
+        if (y == 0 && chunkRows >= pImage->height)
+        {
+            slices = min(chunkRows / pImage->height, pImage->depth - z);
+        }
+
+        VkDeviceSize const size = rowSize * rows * slices;
+        VkDeviceSize const offset = arStagingAlloc(size);
+        memcpy((char*)g.stagingBuffer.pMapped + offset, (char const*)pData + row * rowSize, size);
+
+        VkBufferImageCopy region;
+        region.bufferOffset = offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset.x = 0;
+        region.imageOffset.y = (int32_t)y;
+        region.imageOffset.z = (int32_t)z;
+        region.imageExtent.width  = pImage->width;
+        region.imageExtent.height = rows;
+        region.imageExtent.depth  = slices;
+        g.vkCmdCopyBufferToImage(
+            g.pTransfer->cmd,
+            g.stagingBuffer.handle.data[0],
+            pImage->handle.data[0],
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &region);
+
+        row += rows * slices;
+    }
+
+    imageMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    imageMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    arReleaseToGraphics(NULL, &imageMemoryBarrier);
+
+    uint64_t const value = arEndUpload();
+
+    // Inside a batch the wait stays with the batch until it is submitted.
+    if (!g.uploadBatch)
+    {
+        g.transferWaitFrame = 0;
+    }
+
+    return(value);
+}
+
+void
+arDestroyImage(
+    ArImage const* pImage)
+{
+    g.vkDestroyImageView(g.device, pImage->handle.data[2], NULL);
+    g.vkDestroyImage(g.device, pImage->handle.data[0], NULL);
+    arReleaseImageMemory(pImage->handle.data[1]);
+}
+
+void
+arDestroyImageDeferred(
+    ArImage const* pImage)
+{
+    ArDeferredDestroy entry;
+    entry.buffer = NULL;
+    entry.image = pImage->handle.data[0];
+    entry.view = pImage->handle.data[2];
+    entry.pipeline = NULL;
+    entry.pAllocation = pImage->handle.data[1];
+    arDeferDestroy(&entry);
+}
+
+void
+arCreateShaderFromFile(
+    ArShader* pShader,
+    char const* filename)
+{
+#if defined(AR_PLATFORM_WIN32)
+    LARGE_INTEGER fileSize;
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE ||
+        !GetFileSizeEx(file, &fileSize))
+    {
+        arError("Failed to create file");
+    }
+
+    uint32_t* pBuffer = HeapAlloc(GetProcessHeap(), 0, fileSize.QuadPart);
+    DWORD bytesRead;
+
+    if (!pBuffer)
+    {
+        arError("Failed to allocate memory");
+    }
+
+    if (!ReadFile(file, pBuffer, fileSize.LowPart, &bytesRead, NULL))
+    {
+        arError("Failed to read shader file");
+    }
+
+    CloseHandle(file);
+    arCreateShaderFromMemory(pShader, pBuffer, fileSize.QuadPart);
+    HeapFree(GetProcessHeap(), 0, pBuffer);
+#elif defined(AR_PLATFORM_POSIX)
+    FILE* file = fopen(filename, "rb");
+
+    if (!file || fseek(file, 0, SEEK_END))
+    {
+        arError("Failed to create file");
+    }
+
+    long fileSize = ftell(file);
+    rewind(file);
+
+    uint32_t* pBuffer = malloc(fileSize);
+
+    if (!pBuffer)
+    {
+        arError("Failed to allocate memory");
+    }
+
+    if (fread(pBuffer, 1, fileSize, file) != (size_t)fileSize)
+    {
+        arError("Failed to read shader file");
+    }
+
+    fclose(file);
+    arCreateShaderFromMemory(pShader, pBuffer, fileSize);
+    free(pBuffer);
+#endif
+}
+
+void
+arCreateShaderFromMemory(
+    ArShader* pShader,
+    uint32_t const* pCode,
+    size_t codeSize)
+{
+    VkShaderModuleCreateInfo shaderModuleCreateInfo;
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.pNext = NULL;
+    shaderModuleCreateInfo.flags = 0;
+    shaderModuleCreateInfo.codeSize = codeSize;
+    shaderModuleCreateInfo.pCode = pCode;
+    arVkCheck(g.vkCreateShaderModule(g.device, &shaderModuleCreateInfo, NULL, (VkShaderModule*)pShader));
+}
+
+void
+arDestroyShader(
+    ArShader const* pShader)
+{
+    g.vkDestroyShaderModule(g.device, pShader->handle.data, NULL);
+}
+
+void
+arCreateGraphicsPipeline(
+    ArPipeline* pPipeline,
+    ArGraphicsPipelineCreateInfo const* pPipelineCreateInfo)
+{
+    VkFormat colorFormats[8];
+    colorFormats[0] = VK_FORMAT_B8G8R8A8_UNORM;
+    colorFormats[1] = VK_FORMAT_B8G8R8A8_UNORM;
+    colorFormats[2] = VK_FORMAT_B8G8R8A8_UNORM;
+    colorFormats[3] = VK_FORMAT_B8G8R8A8_UNORM;
+    colorFormats[4] = VK_FORMAT_B8G8R8A8_UNORM;
+    colorFormats[5] = VK_FORMAT_B8G8R8A8_UNORM;
+    colorFormats[6] = VK_FORMAT_B8G8R8A8_UNORM;
+    colorFormats[7] = VK_FORMAT_B8G8R8A8_UNORM;
+
+    VkPipelineColorBlendAttachmentState blendAttachments[8];
+    for (uint32_t i = pPipelineCreateInfo->blendAttachmentCount; i--; )
+    {
+        blendAttachments[i].blendEnable         = pPipelineCreateInfo->pBlendAttachments[i].blendEnable;
+        blendAttachments[i].srcColorBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].srcColorFactor;
+        blendAttachments[i].dstColorBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].dstColorFactor;
+        blendAttachments[i].colorBlendOp        = (VkBlendOp)pPipelineCreateInfo->pBlendAttachments[i].colorBlendOp;
+        blendAttachments[i].srcAlphaBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].srcAlphaFactor;
+        blendAttachments[i].dstAlphaBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].dstAlphaFactor;
+        blendAttachments[i].alphaBlendOp        = (VkBlendOp)pPipelineCreateInfo->pBlendAttachments[i].alphaBlendOp;
+        blendAttachments[i].colorWriteMask      = pPipelineCreateInfo->pBlendAttachments[i].colorWriteMask;
+    }
+
+    VkPipelineRenderingCreateInfo renderingCreateInfo;
+    renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingCreateInfo.pNext = NULL;
+    renderingCreateInfo.viewMask = 0;
+    renderingCreateInfo.colorAttachmentCount = pPipelineCreateInfo->blendAttachmentCount;
+    renderingCreateInfo.pColorAttachmentFormats = colorFormats;
+    renderingCreateInfo.depthAttachmentFormat = VK_FORMAT_D32_SFLOAT;
+    renderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].pNext = NULL;
+    shaderStages[0].flags = 0;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = pPipelineCreateInfo->vertShader.handle.data;
+    shaderStages[0].pName = "main";
+    shaderStages[0].pSpecializationInfo = NULL;
+
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].pNext = NULL;
+    shaderStages[1].flags = 0;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = pPipelineCreateInfo->fragShader.handle.data;
+    shaderStages[1].pName = "main";
+    shaderStages[1].pSpecializationInfo = NULL;
+
+    VkPipelineVertexInputStateCreateInfo vertexInputState;
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputState.pNext = NULL;
+    vertexInputState.flags = 0;
+    vertexInputState.vertexBindingDescriptionCount = 0;
+    vertexInputState.vertexAttributeDescriptionCount = 0;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+    inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyState.pNext = NULL;
+    inputAssemblyState.flags = 0;
+    inputAssemblyState.primitiveRestartEnable = false;
+    inputAssemblyState.topology = (VkPrimitiveTopology)pPipelineCreateInfo->topology;
+
+    VkPipelineViewportStateCreateInfo viewportState;
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.pNext = NULL;
+    viewportState.flags = 0;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = NULL;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = NULL;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState;
+    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.pNext = NULL;
+    rasterizationState.flags = 0;
+    rasterizationState.depthClampEnable = false;
+    rasterizationState.rasterizerDiscardEnable = false;
+    rasterizationState.polygonMode = (VkPolygonMode)pPipelineCreateInfo->polygonMode;
+    rasterizationState.cullMode = pPipelineCreateInfo->cullMode;
+    rasterizationState.frontFace = (VkFrontFace)pPipelineCreateInfo->frontFace;
+    rasterizationState.depthBiasEnable = false;
+    rasterizationState.lineWidth = 1.0f;
+    rasterizationState.depthBiasClamp = 0.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleState;
+    multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleState.pNext = NULL;
+    multisampleState.flags = 0;
+    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampleState.sampleShadingEnable = false;
+    multisampleState.pSampleMask = NULL;
+    multisampleState.alphaToCoverageEnable = false;
+    multisampleState.alphaToOneEnable = false;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilState;
+    depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilState.pNext = NULL;
+    depthStencilState.flags = 0;
+    depthStencilState.stencilTestEnable = false;
+    depthStencilState.depthBoundsTestEnable = false;
+    depthStencilState.depthWriteEnable = pPipelineCreateInfo->depthState.depthWriteEnable;
+    depthStencilState.depthTestEnable = pPipelineCreateInfo->depthState.depthTestEnable;
+    depthStencilState.depthCompareOp = (VkCompareOp)pPipelineCreateInfo->depthState.compareOp;
+    depthStencilState.front.failOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.front.passOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.front.depthFailOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.front.compareOp = VK_COMPARE_OP_NEVER;
+    depthStencilState.front.compareMask = 0;
+    depthStencilState.front.writeMask = 0;
+    depthStencilState.front.reference = 0;
+    depthStencilState.back.failOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.back.passOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.back.depthFailOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.back.compareOp = VK_COMPARE_OP_NEVER;
+    depthStencilState.back.compareMask = 0;
+    depthStencilState.back.writeMask = 0;
+    depthStencilState.back.reference = 0;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendState;
+    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendState.pNext = NULL;
+    colorBlendState.flags = 0;
+    colorBlendState.logicOpEnable = false;
+    colorBlendState.logicOp = VK_LOGIC_OP_COPY;
+    colorBlendState.attachmentCount = pPipelineCreateInfo->blendAttachmentCount;
+    colorBlendState.pAttachments = blendAttachments;
+
+    VkDynamicState dynamicStates[2];
+    dynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
+    dynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+
+    VkPipelineDynamicStateCreateInfo dynamicState;
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.pNext = NULL;
+    dynamicState.flags = 0;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = &renderingCreateInfo;
+    pipelineCreateInfo.flags = 0;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = shaderStages;
+    pipelineCreateInfo.pVertexInputState = &vertexInputState;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+    pipelineCreateInfo.pTessellationState = NULL;
+    pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pRasterizationState = &rasterizationState;
+    pipelineCreateInfo.pMultisampleState = &multisampleState;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+    pipelineCreateInfo.pColorBlendState = &colorBlendState;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
+    pipelineCreateInfo.layout = g.pipelineLayout;
+    pipelineCreateInfo.renderPass = NULL;
+    arVkCheck(g.vkCreateGraphicsPipelines(g.device, NULL, 1, &pipelineCreateInfo, NULL, (VkPipeline*)pPipeline));
+}
+
+void
+arDestroyPipeline(
+    ArPipeline const* pPipeline)
+{
+    g.vkDestroyPipeline(g.device, pPipeline->handle.data, NULL);
+}
 
-        VkPhysicalDeviceFeatures2 features;
-        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-        features.pNext = &vulkan13Features;
-        features.features.robustBufferAccess = false;
-        features.features.fullDrawIndexUint32 = true;
-        features.features.imageCubeArray = false;
-        features.features.independentBlend = false;
-        features.features.geometryShader = false;
-        features.features.tessellationShader = false;
-        features.features.sampleRateShading = false;
-        features.features.dualSrcBlend = false;
-        features.features.logicOp = false;
-        features.features.multiDrawIndirect = true;
-        features.features.drawIndirectFirstInstance = true;
-        features.features.depthClamp = false;
-        features.features.depthBiasClamp = false;
-        features.features.fillModeNonSolid = true;
-        features.features.depthBounds = false;
-        features.features.wideLines = false;
-        features.features.largePoints = false;
-        features.features.alphaToOne = false;
-        features.features.multiViewport = false;
-        features.features.samplerAnisotropy = false;
-        features.features.textureCompressionETC2 = false;
-        features.features.textureCompressionASTC_LDR = false;
-        features.features.textureCompressionBC = false;
-        features.features.occlusionQueryPrecise = false;
-        features.features.pipelineStatisticsQuery = false;
-        features.features.vertexPipelineStoresAndAtomics = false;
-        features.features.fragmentStoresAndAtomics = false;
-        features.features.shaderTessellationAndGeometryPointSize = false;
-        features.features.shaderImageGatherExtended = false;
-        features.features.shaderStorageImageExtendedFormats = false;
-        features.features.shaderStorageImageMultisample = false;
-        features.features.shaderStorageImageReadWithoutFormat = false;
-        features.features.shaderStorageImageWriteWithoutFormat = false;
-        features.features.shaderUniformBufferArrayDynamicIndexing = false;
-        features.features.shaderSampledImageArrayDynamicIndexing = false;
-        features.features.shaderStorageBufferArrayDynamicIndexing = false;
-        features.features.shaderStorageImageArrayDynamicIndexing = false;
-        features.features.shaderClipDistance = false;
-        features.features.shaderCullDistance = false;
-        features.features.shaderFloat64 = false;
-        features.features.shaderInt64 = false;
-        features.features.shaderInt16 = false;
-        features.features.shaderResourceResidency = false;
-        features.features.shaderResourceMinLod = false;
-        features.features.sparseBinding = false;
-        features.features.sparseResidencyBuffer = false;
-        features.features.sparseResidencyImage2D = false;
-        features.features.sparseResidencyImage3D = false;
-        features.features.sparseResidency2Samples = false;
-        features.features.sparseResidency4Samples = false;
-        features.features.sparseResidency8Samples = false;
-        features.features.sparseResidency16Samples = false;
-        features.features.sparseResidencyAliased = false;
-        features.features.variableMultisampleRate = false;
-        features.features.inheritedQueries = false;
+void
+arDestroyPipelineDeferred(
+    ArPipeline const* pPipeline)
+{
+    ArDeferredDestroy entry;
+    entry.buffer = NULL;
+    entry.image = NULL;
+    entry.view = NULL;
+    entry.pipeline = pPipeline->handle.data;
+    entry.pAllocation = NULL;
+    arDeferDestroy(&entry);
+}
+
+void
+arCmdBeginRendering(
+    uint32_t colorAttachmentCount,
+    ArAttachment const* pColorAttachments,
+    ArAttachment const* pDepthAttachment)
+{
+    ArCommandBeginRendering* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_BEGIN_RENDERING,
+        offsetof(ArCommandBeginRendering, colorAttachments) + colorAttachmentCount * sizeof(VkRenderingAttachmentInfo));
+
+    g.renderingOffset = (size_t)((char*)pArgs - g.commandStream.pData);
+    pArgs->flags = 0;
+    pArgs->colorAttachmentCount = colorAttachmentCount;
+    pArgs->hasDepthAttachment = pDepthAttachment != NULL;
+
+    if (pDepthAttachment)
+    {
+        VkRenderingAttachmentInfo* pDepth = &pArgs->depthAttachment;
+        pDepth->sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        pDepth->pNext = NULL;
+        pDepth->imageView = pDepthAttachment->pImage->handle.data[2];
+        pDepth->imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+        pDepth->resolveMode = VK_RESOLVE_MODE_NONE;
+        pDepth->resolveImageView = NULL;
+        pDepth->resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        pDepth->loadOp = (VkAttachmentLoadOp)pDepthAttachment->loadOp;
+        pDepth->storeOp = (VkAttachmentStoreOp)pDepthAttachment->storeOp;
+        pDepth->clearValue.depthStencil.depth = pDepthAttachment->clearValue.depth;
+        pDepth->clearValue.depthStencil.stencil = 0;
+    }
+
+    for (uint32_t i = 0; i < colorAttachmentCount; ++i)
+    {
+        VkRenderingAttachmentInfo* pAttachment = &pArgs->colorAttachments[i];
+
+        if (!pColorAttachments[i].pImage)
+        {
+            pAttachment->imageView = NULL;
+        }
+        else
+        {
+            pAttachment->imageView = pColorAttachments[i].pImage->handle.data[2];
+        }
+
+        pAttachment->sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        pAttachment->pNext = NULL;
+        pAttachment->imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        pAttachment->resolveMode = VK_RESOLVE_MODE_NONE;
+        pAttachment->resolveImageView = NULL;
+        pAttachment->resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        pAttachment->loadOp = (VkAttachmentLoadOp)pColorAttachments[i].loadOp;
+        pAttachment->storeOp = (VkAttachmentStoreOp)pColorAttachments[i].storeOp;
+        pAttachment->clearValue.color.int32[0] = pColorAttachments[i].clearValue.color.int32[0];
+        pAttachment->clearValue.color.int32[1] = pColorAttachments[i].clearValue.color.int32[1];
+        pAttachment->clearValue.color.int32[2] = pColorAttachments[i].clearValue.color.int32[2];
+        pAttachment->clearValue.color.int32[3] = pColorAttachments[i].clearValue.color.int32[3];
+    }
+
+    if (pColorAttachments->pImage)
+    {
+        pArgs->extent.width  = pColorAttachments->pImage->width;
+        pArgs->extent.height = pColorAttachments->pImage->height;
+    }
+    else
+    {
+        pArgs->extent.width  = g.extent.width;
+        pArgs->extent.height = g.extent.height;
+    }
+}
+
+void
+arCmdEndRendering(void)
+{
+    arCommandPush(&g.commandStream, AR_COMMAND_END_RENDERING, 0);
+    g.renderingOffset = SIZE_MAX;
+}
+
+void
+arCmdPushConstants(
+    uint32_t offset,
+    uint32_t size,
+    void const* pValues)
+{
+    ArCommandPushConstants* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_PUSH_CONSTANTS,
+        offsetof(ArCommandPushConstants, values) + size);
+
+    pArgs->offset = offset;
+    pArgs->size = size;
+    memcpy(pArgs->values, pValues, size);
+}
+
+void
+arCmdBindIndexBuffer(
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    ArIndexType indexType)
+{
+    ArCommandBindIndexBuffer* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_BIND_INDEX_BUFFER,
+        sizeof(ArCommandBindIndexBuffer));
+
+    pArgs->buffer = *pBuffer->handle.data;
+    pArgs->offset = offset;
+    pArgs->indexType = (VkIndexType)indexType;
+}
+
+void
+arCmdBindGraphicsPipeline(
+    ArPipeline const* pPipeline)
+{
+    ArCommandBindPipeline* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_BIND_PIPELINE,
+        sizeof(ArCommandBindPipeline));
+
+    pArgs->pipeline = pPipeline->handle.data;
+}
+
+internal VkPipelineStageFlags2
+arImageLayoutToPipelineStage(
+    ArImageLayout layout)
+{
+    switch (layout)
+    {
+    case AR_IMAGE_LAYOUT_COLOR_ATTACHMENT:
+        return(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT); 
+    case AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT:
+        return(VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+               VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT);
+    case AR_IMAGE_LAYOUT_SHADER_READ:
+        return(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+    case AR_IMAGE_LAYOUT_TRANSFER_SRC:
+    case AR_IMAGE_LAYOUT_TRANSFER_DST:
+        return(VK_PIPELINE_STAGE_2_TRANSFER_BIT);
+    case AR_IMAGE_LAYOUT_PRESENT_SRC:
+        return(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+    default:
+        return(VK_PIPELINE_STAGE_2_NONE);
+    }
+}
+
+internal VkAccessFlags2
+arImageLayoutToAccess(
+    ArImageLayout layout)
+{
+    switch (layout)
+    {
+    case AR_IMAGE_LAYOUT_COLOR_ATTACHMENT:
+        return(VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT); 
+    case AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT:
+        return(VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+    case AR_IMAGE_LAYOUT_SHADER_READ:
+        return(VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    case AR_IMAGE_LAYOUT_TRANSFER_SRC:
+        return(VK_ACCESS_2_TRANSFER_READ_BIT);
+    case AR_IMAGE_LAYOUT_TRANSFER_DST:
+        return(VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    default:
+        return(VK_ACCESS_2_NONE);
+    }
+}
+
+void
+arCmdPipelineBarrier(
+    uint32_t barrierCount,
+    ArBarrier const* pBarriers)
+{
+    ArCommandPipelineBarrier* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_PIPELINE_BARRIER,
+        offsetof(ArCommandPipelineBarrier, barriers) + barrierCount * sizeof(VkImageMemoryBarrier2));
+
+    VkImageMemoryBarrier2* imageMemoryBarriers = pArgs->barriers;
+    pArgs->barrierCount = barrierCount;
+
+    for (uint32_t i = 0; i < barrierCount; ++i)
+    {
+        imageMemoryBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        imageMemoryBarriers[i].pNext = NULL;
+        imageMemoryBarriers[i].srcStageMask = arImageLayoutToPipelineStage(pBarriers[i].oldLayout);
+        imageMemoryBarriers[i].srcAccessMask = arImageLayoutToAccess(pBarriers[i].oldLayout);
+        imageMemoryBarriers[i].dstStageMask = arImageLayoutToPipelineStage(pBarriers[i].newLayout);
+        imageMemoryBarriers[i].dstAccessMask = arImageLayoutToAccess(pBarriers[i].newLayout);
+        imageMemoryBarriers[i].oldLayout = (VkImageLayout)pBarriers[i].oldLayout;
+        imageMemoryBarriers[i].newLayout = (VkImageLayout)pBarriers[i].newLayout;
+        imageMemoryBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageMemoryBarriers[i].subresourceRange.baseArrayLayer = 0;
+        imageMemoryBarriers[i].subresourceRange.baseMipLevel = 0;
+        imageMemoryBarriers[i].subresourceRange.layerCount = 1;
+        imageMemoryBarriers[i].subresourceRange.levelCount = 1;
+
+        if (pBarriers[i].pImage)
+        {
+            imageMemoryBarriers[i].image = *pBarriers[i].pImage->handle.data;
+        }
+        else
+        {
+            imageMemoryBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+            imageMemoryBarriers[i].image = NULL;
+        }
+
+        if (pBarriers[i].newLayout == AR_IMAGE_LAYOUT_PRESENT_SRC)
+        {
+            imageMemoryBarriers[i].newLayout = g.headless ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            
+            if (!g.unifiedQueue)
+            {
+                imageMemoryBarriers[i].dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+                imageMemoryBarriers[i].srcQueueFamilyIndex = g.graphicsQueueFamily;
+                imageMemoryBarriers[i].dstQueueFamilyIndex = g.presentQueueFamily;
+            }
+        }
+        else if (pBarriers[i].oldLayout == AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT ||
+                 pBarriers[i].newLayout == AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT)
+        {
+            imageMemoryBarriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+    }
+}
+
+void
+arCmdDraw(
+    uint32_t vertexCount,
+    uint32_t instanceCount,
+    uint32_t firstVertex,
+    uint32_t firstInstance)
+{
+    ArCommandDraw* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_DRAW,
+        sizeof(ArCommandDraw));
+
+    pArgs->vertexCount = vertexCount;
+    pArgs->instanceCount = instanceCount;
+    pArgs->firstVertex = firstVertex;
+    pArgs->firstInstance = firstInstance;
+}
 
-        VkDeviceCreateInfo deviceCreateInfo;
-        deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        deviceCreateInfo.pNext = &features;
-        deviceCreateInfo.flags = 0;
-        deviceCreateInfo.queueCreateInfoCount = 2 - g.unifiedQueue;
-        deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
-        deviceCreateInfo.enabledLayerCount = 0;
-        deviceCreateInfo.enabledExtensionCount = 1;
-        deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
-        deviceCreateInfo.pEnabledFeatures = NULL;
-        arVkCheck(g.vkCreateDevice(g.gpu, &deviceCreateInfo, NULL, &g.device));
-        arLoadDeviceFunctions();
+internal void
+arCmdPushDrawIndirect(
+    ArCommandType type,
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    ArBuffer const* pCountBuffer,
+    uint64_t countBufferOffset,
+    uint32_t drawCount,
+    uint32_t stride)
+{
+    ArCommandDrawIndirect* pArgs = arCommandPush(
+        &g.commandStream,
+        type,
+        sizeof(ArCommandDrawIndirect));
+
+    pArgs->buffer = *pBuffer->handle.data;
+    pArgs->offset = offset;
+    pArgs->countBuffer = pCountBuffer ? *pCountBuffer->handle.data : NULL;
+    pArgs->countBufferOffset = countBufferOffset;
+    pArgs->drawCount = drawCount;
+    pArgs->stride = stride;
+}
 
-        g.vkGetDeviceQueue(g.device, g.graphicsQueueFamily, 0, &g.graphicsQueue);
-        g.vkGetDeviceQueue(g.device, g.presentQueueFamily,  0, &g.presentQueue);
-    }
-    {
-        VkCommandPoolCreateInfo commandPoolCreateInfo;
-        commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        commandPoolCreateInfo.pNext = NULL;
-        commandPoolCreateInfo.flags = 0;
-        commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
-        arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &g.transferCommandPool));
+void
+arCmdDrawIndirect(
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    uint32_t drawCount,
+    uint32_t stride)
+{
+    arCmdPushDrawIndirect(
+        AR_COMMAND_DRAW_INDIRECT,
+        pBuffer,
+        offset,
+        NULL,
+        0,
+        drawCount,
+        stride);
+}
 
-        VkCommandBufferAllocateInfo commandBufferAllocateInfo;
-        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        commandBufferAllocateInfo.pNext = NULL;
-        commandBufferAllocateInfo.commandPool = g.transferCommandPool;
-        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        commandBufferAllocateInfo.commandBufferCount = 1;
-        arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, &g.transferCommandBuffer));
-    }
-    {
-        VkSemaphoreCreateInfo semaphoreCreateInfo;
-        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        semaphoreCreateInfo.pNext = NULL;
-        semaphoreCreateInfo.flags = 0;
+void
+arCmdDrawIndirectCount(
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    ArBuffer const* pCountBuffer,
+    uint64_t countBufferOffset,
+    uint32_t maxDrawCount,
+    uint32_t stride)
+{
+    arCmdPushDrawIndirect(
+        AR_COMMAND_DRAW_INDIRECT_COUNT,
+        pBuffer,
+        offset,
+        pCountBuffer,
+        countBufferOffset,
+        maxDrawCount,
+        stride);
+}
 
-        if (!g.unifiedQueue)
-        arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.preSemaphore.semaphore));
-        arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.acqSemaphore.semaphore));
-        arVkCheck(g.vkCreateSemaphore(g.device, &semaphoreCreateInfo, NULL, &g.renSemaphore.semaphore));
+void
+arCmdDrawIndexed(
+    uint32_t indexCount,
+    uint32_t instanceCount,
+    uint32_t firstIndex,
+    int32_t vertexOffset,
+    uint32_t firstInstance)
+{
+    ArCommandDrawIndexed* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_DRAW_INDEXED,
+        sizeof(ArCommandDrawIndexed));
+
+    pArgs->indexCount = indexCount;
+    pArgs->instanceCount = instanceCount;
+    pArgs->firstIndex = firstIndex;
+    pArgs->vertexOffset = vertexOffset;
+    pArgs->firstInstance = firstInstance;
+}
+
+void
+arCmdDrawIndexedIndirect(
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    uint32_t drawCount,
+    uint32_t stride)
+{
+    arCmdPushDrawIndirect(
+        AR_COMMAND_DRAW_INDEXED_INDIRECT,
+        pBuffer,
+        offset,
+        NULL,
+        0,
+        drawCount,
+        stride);
+}
+
+void
+arCmdDrawIndexedIndirectCount(
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    ArBuffer const* pCountBuffer,
+    uint64_t countBufferOffset,
+    uint32_t maxDrawCount,
+    uint32_t stride)
+{
+    arCmdPushDrawIndirect(
+        AR_COMMAND_DRAW_INDEXED_INDIRECT_COUNT,
+        pBuffer,
+        offset,
+        pCountBuffer,
+        countBufferOffset,
+        maxDrawCount,
+        stride);
+}
 
-        VkFenceCreateInfo fenceCreateInfo;
-        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceCreateInfo.pNext = NULL;
-        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        arVkCheck(g.vkCreateFence(g.device, &fenceCreateInfo, NULL, &g.fence));
+void
+arBeginParallelRecording(
+    uint32_t cmdCount,
+    ArCmd* pCmds)
+{
+    if (cmdCount > AR_MAX_RECORDING_THREADS)
+    {
+        arError("Too many parallel command buffers");
     }
+
+    if (g.renderingOffset == SIZE_MAX)
     {
-        VkDescriptorPoolSize poolSizes[1];
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[0].descriptorCount = 500000;
+        arError("Parallel recording must be inside arCmdBeginRendering");
+    }
 
-        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
-        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        descriptorPoolCreateInfo.pNext = NULL;
-        descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
-        descriptorPoolCreateInfo.maxSets = 1;
-        descriptorPoolCreateInfo.poolSizeCount = 1;
-        descriptorPoolCreateInfo.pPoolSizes = poolSizes;
-        arVkCheck(g.vkCreateDescriptorPool(g.device, &descriptorPoolCreateInfo, NULL, &g.descriptorPool));
+    // Rendering that executes secondaries cannot record anything inline in the primary.
+    ArCommandBeginRendering* pRendering = (ArCommandBeginRendering*)(g.commandStream.pData + g.renderingOffset);
+    pRendering->flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
 
-        VkDescriptorBindingFlags bindingFlags[1];
-        bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    VkFormat colorFormats[8];
 
-        VkDescriptorSetLayoutBindingFlagsCreateInfo descriptorSetLayoutBindingFlags;
-        descriptorSetLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-        descriptorSetLayoutBindingFlags.pNext = NULL;
-        descriptorSetLayoutBindingFlags.bindingCount = 1;
-        descriptorSetLayoutBindingFlags.pBindingFlags = bindingFlags;
+    for (uint32_t i = pRendering->colorAttachmentCount; i--; )
+    {
+        colorFormats[i] = VK_FORMAT_B8G8R8A8_UNORM;
+    }
 
-        VkDescriptorSetLayoutBinding bindings[1];
-        bindings[0].binding = 0;
-        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        bindings[0].descriptorCount = 500000;
-        bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        bindings[0].pImmutableSamplers = NULL;
+    VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo;
+    inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritanceRenderingInfo.pNext = NULL;
+    inheritanceRenderingInfo.flags = 0;
+    inheritanceRenderingInfo.viewMask = 0;
+    inheritanceRenderingInfo.colorAttachmentCount = pRendering->colorAttachmentCount;
+    inheritanceRenderingInfo.pColorAttachmentFormats = colorFormats;
+    inheritanceRenderingInfo.depthAttachmentFormat = pRendering->hasDepthAttachment ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_UNDEFINED;
+    inheritanceRenderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+    inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo;
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = &inheritanceRenderingInfo;
+    inheritanceInfo.renderPass = VK_NULL_HANDLE;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+    inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+    inheritanceInfo.queryFlags = 0;
+    inheritanceInfo.pipelineStatistics = 0;
+
+    // Pre-recorded secondaries are executed by every swapchain image's command buffer.
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = NULL;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    commandBufferBeginInfo.flags |= g.immediateRecording ?
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT :
+        VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
-        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        descriptorSetLayoutCreateInfo.pNext = &descriptorSetLayoutBindingFlags;
-        descriptorSetLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
-        descriptorSetLayoutCreateInfo.bindingCount = 1;
-        descriptorSetLayoutCreateInfo.pBindings = bindings;
-        arVkCheck(g.vkCreateDescriptorSetLayout(g.device, &descriptorSetLayoutCreateInfo, NULL, &g.descriptorSetLayout));
+    VkRect2D scissor;
+    scissor.offset.x = 0;
+    scissor.offset.y = 0;
+    scissor.extent = pRendering->extent;
 
-        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
-        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        descriptorSetAllocateInfo.pNext = NULL;
-        descriptorSetAllocateInfo.descriptorPool = g.descriptorPool;
-        descriptorSetAllocateInfo.descriptorSetCount = 1;
-        descriptorSetAllocateInfo.pSetLayouts = &g.descriptorSetLayout;
-        arVkCheck(g.vkAllocateDescriptorSets(g.device, &descriptorSetAllocateInfo, &g.descriptorSet));
-    }
-    {
-        VkPushConstantRange pushConstantRange;
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = 128;
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width  = (float)pRendering->extent.width;
+    viewport.height = (float)pRendering->extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
-        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutCreateInfo.pNext = NULL;
-        pipelineLayoutCreateInfo.flags = 0;
-        pipelineLayoutCreateInfo.setLayoutCount = 1;
-        pipelineLayoutCreateInfo.pSetLayouts = &g.descriptorSetLayout;
-        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-        arVkCheck(g.vkCreatePipelineLayout(g.device, &pipelineLayoutCreateInfo, NULL, &g.pipelineLayout));
-    }
+    for (uint32_t i = 0; i < cmdCount; ++i)
     {
-        VkSamplerCreateInfo samplerCreateInfo;
-        samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerCreateInfo.pNext = NULL;
-        samplerCreateInfo.flags = 0;
-        samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
-        samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
-        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerCreateInfo.mipLodBias = 0.0f;
-        samplerCreateInfo.anisotropyEnable = false;
-        samplerCreateInfo.maxAnisotropy = 0.0f;
-        samplerCreateInfo.compareEnable = false;
-        samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
-        samplerCreateInfo.minLod = 0.0f;
-        samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
-        samplerCreateInfo.unnormalizedCoordinates = false;
-        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerLinearToEdge));
+        ArRecordingPool* pPool = &g.recordingPools[g.recordingSet][i];
 
-        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerLinearRepeat));
+        if (pPool->usedCount == AR_MAX_PARALLEL_SECTIONS)
+        {
+            arError("Too many parallel recording sections in one frame");
+        }
 
-        samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
-        samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
-        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerNearestRepeat));
+        if (!pPool->pool)
+        {
+            VkCommandPoolCreateInfo commandPoolCreateInfo;
+            commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            commandPoolCreateInfo.pNext = NULL;
+            commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            commandPoolCreateInfo.queueFamilyIndex = g.graphicsQueueFamily;
 
-        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-        arVkCheck(g.vkCreateSampler(g.device, &samplerCreateInfo, NULL, &g.samplerNearestToEdge));
+            arVkCheck(g.vkCreateCommandPool(g.device, &commandPoolCreateInfo, NULL, &pPool->pool));
+        }
+
+        if (pPool->usedCount == pPool->commandBufferCount)
+        {
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            commandBufferAllocateInfo.pNext = NULL;
+            commandBufferAllocateInfo.commandPool = pPool->pool;
+            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            commandBufferAllocateInfo.commandBufferCount = 1;
+
+            arVkCheck(g.vkAllocateCommandBuffers(g.device, &commandBufferAllocateInfo, &pPool->commandBuffers[pPool->commandBufferCount++]));
+        }
+
+        VkCommandBuffer cmd = pPool->commandBuffers[pPool->usedCount++];
+        arVkCheck(g.vkBeginCommandBuffer(cmd, &commandBufferBeginInfo));
+
+        g.vkCmdBindDescriptorSets(
+            cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            g.pipelineLayout, 0, 1, &g.descriptorSet, 0, NULL);
+        g.vkCmdSetScissor(cmd, 0, 1, &scissor);
+        g.vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+        g.parallelCmds[i] = cmd;
+        pCmds[i].handle.data = cmd;
     }
+
+    g.parallelCmdCount = cmdCount;
+}
+
+void
+arEndParallelRecording(void)
+{
+    for (uint32_t i = g.parallelCmdCount; i--; )
     {
-        arSwapchainCreate(g.vsyncEnabled);
+        arVkCheck(g.vkEndCommandBuffer(g.parallelCmds[i]));
     }
-    {
-        g.graphicsCommandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
-        g.graphicsCommandBufferInfo.pNext = NULL;
-        g.graphicsCommandBufferInfo.deviceMask = 0;
-
-        g.presentCommandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
-        g.presentCommandBufferInfo.pNext = NULL;
-        g.presentCommandBufferInfo.deviceMask = 0;
 
-        g.acqSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-        g.acqSemaphore.pNext = NULL;
-        g.acqSemaphore.value = 0;
-        g.acqSemaphore.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-        g.acqSemaphore.deviceIndex = 0;
+    ArCommandExecuteCommands* pArgs = arCommandPush(
+        &g.commandStream,
+        AR_COMMAND_EXECUTE_COMMANDS,
+        offsetof(ArCommandExecuteCommands, commandBuffers) + g.parallelCmdCount * sizeof(VkCommandBuffer));
 
-        g.renSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-        g.renSemaphore.pNext = NULL;
-        g.renSemaphore.value = 0;
-        g.renSemaphore.stageMask = g.unifiedQueue ? VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-        g.renSemaphore.deviceIndex = 0;
+    pArgs->commandBufferCount = g.parallelCmdCount;
+    memcpy(pArgs->commandBuffers, g.parallelCmds, g.parallelCmdCount * sizeof(VkCommandBuffer));
+    g.parallelCmdCount = 0;
+}
 
-        g.preSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-        g.preSemaphore.pNext = NULL;
-        g.preSemaphore.value = 0;
-        g.preSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-        g.preSemaphore.deviceIndex = 0;
-    }
+void
+arCmdPushConstantsEx(
+    ArCmd const* pCmd,
+    uint32_t offset,
+    uint32_t size,
+    void const* pValues)
+{
+    g.vkCmdPushConstants(
+        (VkCommandBuffer)pCmd->handle.data,
+        g.pipelineLayout,
+        VK_SHADER_STAGE_VERTEX_BIT,
+        offset,
+        size,
+        pValues);
 }
 
-internal void
-arContextTeardown(void)
+void
+arCmdBindIndexBufferEx(
+    ArCmd const* pCmd,
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    ArIndexType indexType)
 {
-    arSwapchainTeardown();
-
-    if (!g.unifiedQueue)
-    {
-        g.vkDestroySemaphore(g.device, g.preSemaphore.semaphore, NULL);
-    }
-    
-    g.vkDestroyPipelineLayout(g.device, g.pipelineLayout, NULL);
-    g.vkDestroySampler(g.device, g.samplerNearestRepeat, NULL);
-    g.vkDestroySampler(g.device, g.samplerNearestToEdge, NULL);
-    g.vkDestroySampler(g.device, g.samplerLinearRepeat, NULL);
-    g.vkDestroySampler(g.device, g.samplerLinearToEdge, NULL);
-    g.vkDestroyDescriptorSetLayout(g.device, g.descriptorSetLayout, NULL);
-    g.vkDestroyDescriptorPool(g.device, g.descriptorPool, NULL);
-    g.vkDestroyFence(g.device, g.fence, NULL);
-    g.vkDestroySemaphore(g.device, g.renSemaphore.semaphore, NULL);
-    g.vkDestroySemaphore(g.device, g.acqSemaphore.semaphore, NULL);
-    g.vkDestroyCommandPool(g.device, g.transferCommandPool, NULL);
-    g.vkDestroyDevice(g.device, NULL);
-    g.vkDestroySurfaceKHR(g.instance, g.surface, NULL);
-    g.vkDestroyInstance(g.instance, NULL);
+    g.vkCmdBindIndexBuffer((VkCommandBuffer)pCmd->handle.data, *pBuffer->handle.data, offset, (VkIndexType)indexType);
 }
 
-internal void
-arRecordCommands(void)
+void
+arCmdBindGraphicsPipelineEx(
+    ArCmd const* pCmd,
+    ArPipeline const* pPipeline)
 {
-    arVkCheck(g.vkResetCommandPool(g.device, g.graphicsCommandPool, 0));
-
-    for (uint32_t i = g.imageCount; i--; )
-    {
-        VkCommandBufferBeginInfo commandBufferBeginInfo;
-        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        commandBufferBeginInfo.pNext = NULL;
-        commandBufferBeginInfo.flags = 0;
-        commandBufferBeginInfo.pInheritanceInfo = NULL;
+    g.vkCmdBindPipeline((VkCommandBuffer)pCmd->handle.data, VK_PIPELINE_BIND_POINT_GRAPHICS, pPipeline->handle.data);
+}
 
-        g.pFrame = &g.frames[i];
+void
+arCmdDrawEx(
+    ArCmd const* pCmd,
+    uint32_t vertexCount,
+    uint32_t instanceCount,
+    uint32_t firstVertex,
+    uint32_t firstInstance)
+{
+    g.vkCmdDraw((VkCommandBuffer)pCmd->handle.data, vertexCount, instanceCount, firstVertex, firstInstance);
+}
 
-        arVkCheck(g.vkBeginCommandBuffer(g.pFrame->cmd, &commandBufferBeginInfo));
-        g.vkCmdBindDescriptorSets(
-            g.pFrame->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            g.pipelineLayout, 0, 1, &g.descriptorSet, 0, NULL);
-        g.pfnRecordCommands();
-        arVkCheck(g.vkEndCommandBuffer(g.pFrame->cmd));
-    }
+void
+arCmdDrawIndirectEx(
+    ArCmd const* pCmd,
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    uint32_t drawCount,
+    uint32_t stride)
+{
+    g.vkCmdDrawIndirect((VkCommandBuffer)pCmd->handle.data, *pBuffer->handle.data, offset, drawCount, stride);
 }
 
-internal void
-arBeginTransfer(void)
+void
+arCmdDrawIndirectCountEx(
+    ArCmd const* pCmd,
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    ArBuffer const* pCountBuffer,
+    uint64_t countBufferOffset,
+    uint32_t maxDrawCount,
+    uint32_t stride)
 {
-    arVkCheck(g.vkResetCommandPool(g.device, g.transferCommandPool, 0));
+    g.vkCmdDrawIndirectCount(
+        (VkCommandBuffer)pCmd->handle.data,
+        *pBuffer->handle.data,
+        offset,
+        *pCountBuffer->handle.data,
+        countBufferOffset,
+        maxDrawCount,
+        stride);
+}
 
-    VkCommandBufferBeginInfo commandBufferBeginInfo;
-    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    commandBufferBeginInfo.pNext = NULL;
-    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    commandBufferBeginInfo.pInheritanceInfo = NULL;
-    arVkCheck(g.vkBeginCommandBuffer(g.transferCommandBuffer, &commandBufferBeginInfo));
+void
+arCmdDrawIndexedEx(
+    ArCmd const* pCmd,
+    uint32_t indexCount,
+    uint32_t instanceCount,
+    uint32_t firstIndex,
+    int32_t vertexOffset,
+    uint32_t firstInstance)
+{
+    g.vkCmdDrawIndexed((VkCommandBuffer)pCmd->handle.data, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 }
 
-internal void
-arEndTransfer(void)
+void
+arCmdDrawIndexedIndirectEx(
+    ArCmd const* pCmd,
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    uint32_t drawCount,
+    uint32_t stride)
 {
-    arVkCheck(g.vkEndCommandBuffer(g.transferCommandBuffer));
+    g.vkCmdDrawIndexedIndirect((VkCommandBuffer)pCmd->handle.data, *pBuffer->handle.data, offset, drawCount, stride);
+}
 
-    VkCommandBufferSubmitInfo commandBufferInfo;
-    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
-    commandBufferInfo.pNext = NULL;
-    commandBufferInfo.deviceMask = 0;
-    commandBufferInfo.commandBuffer = g.transferCommandBuffer;
+void
+arCmdDrawIndexedIndirectCountEx(
+    ArCmd const* pCmd,
+    ArBuffer const* pBuffer,
+    uint64_t offset,
+    ArBuffer const* pCountBuffer,
+    uint64_t countBufferOffset,
+    uint32_t maxDrawCount,
+    uint32_t stride)
+{
+    g.vkCmdDrawIndexedIndirectCount(
+        (VkCommandBuffer)pCmd->handle.data,
+        *pBuffer->handle.data,
+        offset,
+        *pCountBuffer->handle.data,
+        countBufferOffset,
+        maxDrawCount,
+        stride);
+}
 
-    VkSubmitInfo2 submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-    submitInfo.pNext = NULL;
-    submitInfo.flags = 0;
-    submitInfo.waitSemaphoreInfoCount = 0;
-    submitInfo.commandBufferInfoCount = 1;
-    submitInfo.pCommandBufferInfos = &commandBufferInfo;
-    submitInfo.signalSemaphoreInfoCount = 0;
-    arVkCheck(g.vkQueueSubmit2(g.graphicsQueue, 1, &submitInfo, NULL));
-    arVkCheck(g.vkQueueWaitIdle(g.graphicsQueue));
+void
+arSetWindowTitle(
+    char const* title)
+{
+#if defined(AR_PLATFORM_WIN32)
+    SetWindowTextA(
+        g.hwnd,
+        title);
+#elif defined(AR_PLATFORM_XCB)
+    xcb_change_property(
+        g.connection,
+        XCB_PROP_MODE_REPLACE,
+        g.window,
+        XCB_ATOM_WM_NAME,
+        XCB_ATOM_STRING,
+        8,
+        (uint32_t)strlen(title),
+        title);
+    xcb_flush(g.connection);
+#elif defined(AR_PLATFORM_WAYLAND)
+    xdg_toplevel_set_title(g.toplevel, title);
+    wl_display_flush(g.display);
+#endif
 }
 
-internal uint32_t
-arFindMemoryType(
-    uint32_t typeBitsRequirement,
-    VkMemoryPropertyFlags properties)
+void
+arPollEvents(void)
 {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    g.vkGetPhysicalDeviceMemoryProperties(g.gpu, &memoryProperties);
+    for (ArKeyInternal* key = g.keys; key != g.keys + 260; key += 1)
+    {
+        key->isPressed  = false;
+        key->isReleased = false;
+    }
+
+    g.cursorRelX = 0;
+    g.cursorRelY = 0;
 
-    for (uint32_t memoryIndex = 0;
-         memoryIndex < memoryProperties.memoryTypeCount;
-         ++memoryIndex)
+    if (!g.headless)
     {
-        if ((typeBitsRequirement & (1 << memoryIndex)) &&
-            (memoryProperties.memoryTypes[memoryIndex].propertyFlags
-            & properties) == properties)
+#if defined(AR_PLATFORM_WIN32)
+        MSG msg;
+        while (PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE))
+        {
+            TranslateMessage(&msg);
+            DispatchMessageA(&msg);
+        }
+#elif defined(AR_PLATFORM_XCB)
+        xcb_generic_event_t* event = g.pendingEvent ? g.pendingEvent : xcb_poll_for_event(g.connection);
+        g.pendingEvent = NULL;
+
+        while (event)
         {
-            return(memoryIndex);
+            arXcbHandleEvent(event);
+            free(event);
+            event = xcb_poll_for_queued_event(g.connection);
         }
+
+        if (xcb_connection_has_error(g.connection))
+        {
+            g.windowShouldClose = true;
+        }
+#elif defined(AR_PLATFORM_WAYLAND)
+        while (wl_display_prepare_read(g.display))
+        {
+            wl_display_dispatch_pending(g.display);
+        }
+
+        struct pollfd fd;
+        fd.fd = wl_display_get_fd(g.display);
+        fd.events = POLLIN;
+        wl_display_flush(g.display);
+
+        if (poll(&fd, 1, 0) > 0)
+        {
+            wl_display_read_events(g.display);
+        }
+        else
+        {
+            wl_display_cancel_read(g.display);
+        }
+
+        if (wl_display_dispatch_pending(g.display) < 0)
+        {
+            g.windowShouldClose = true;
+        }
+#endif
     }
 
-    return(UINT32_MAX);
-}
+    double now = arGetTime();
+    g.deltaTime = now - g.previousTime;
+    g.previousTime = now;
 
-internal void
-arAllocBuffer(
-    ArBuffer* pBuffer,
-    bool isDynamic)
-{
-    const VkBufferUsageFlags bufferUsage =
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
-        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    if (g.headless)
+    {
+        return;
+    }
 
-    VkBufferCreateInfo bufferCreateInfo;
-    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferCreateInfo.pNext = NULL;
-    bufferCreateInfo.flags = 0;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    bufferCreateInfo.queueFamilyIndexCount = 0;
-    bufferCreateInfo.size = pBuffer->size;
-    bufferCreateInfo.usage = bufferUsage;
-    arVkCheck(g.vkCreateBuffer(g.device, &bufferCreateInfo, NULL, (VkBuffer*)&pBuffer->handle.data[0]));
+#if defined(AR_PLATFORM_WIN32)
+    POINT cursorPos;
+    GetPhysicalCursorPos(&cursorPos);
 
-    VkMemoryRequirements memoryRequirements;
-    g.vkGetBufferMemoryRequirements(g.device, pBuffer->handle.data[0], &memoryRequirements);
+    g.cursorDeltaX = cursorPos.x - g.globalCursorX;
+    g.cursorDeltaY = cursorPos.y - g.globalCursorY;
 
-    VkMemoryPropertyFlags preferedFlags[2];
-    preferedFlags[0] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    preferedFlags[1] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    g.globalCursorX = cursorPos.x;
+    g.globalCursorY = cursorPos.y;
 
-    VkMemoryPropertyFlags fallbackFlags[2];
-    fallbackFlags[0] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    fallbackFlags[1] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    ScreenToClient(g.hwnd, &cursorPos);
 
-    uint32_t typeIndex = arFindMemoryType(
-        memoryRequirements.memoryTypeBits,
-        preferedFlags[isDynamic]);
+    g.cursorX = cursorPos.x;
+    g.cursorY = cursorPos.y;
+#elif defined(AR_PLATFORM_XCB)
+    g.cursorDeltaX = g.pointerRootX - g.globalCursorX;
+    g.cursorDeltaY = g.pointerRootY - g.globalCursorY;
+
+    g.globalCursorX = g.pointerRootX;
+    g.globalCursorY = g.pointerRootY;
+
+    g.cursorX = g.pointerX;
+    g.cursorY = g.pointerY;
+#elif defined(AR_PLATFORM_WAYLAND)
+    // Wayland exposes no global pointer position, surface coordinates stand in for it.
+    g.cursorDeltaX = g.pointerX - g.globalCursorX;
+    g.cursorDeltaY = g.pointerY - g.globalCursorY;
+
+    g.globalCursorX = g.pointerX;
+    g.globalCursorY = g.pointerY;
+
+    g.cursorX = g.pointerX;
+    g.cursorY = g.pointerY;
+#endif
+}
 
-    if (typeIndex == UINT32_MAX)
+internal void
+arWaitForEvent(void)
+{
+    // Blocks until input arrives without dispatching it, arPollEvents still sees every transition.
+    if (!g.headless)
     {
-        typeIndex = arFindMemoryType(
-            memoryRequirements.memoryTypeBits,
-            fallbackFlags[isDynamic]);
-        
-        if (typeIndex == UINT32_MAX)
+#if defined(AR_PLATFORM_WIN32)
+        WaitMessage();
+#elif defined(AR_PLATFORM_XCB)
+        if (!g.pendingEvent)
         {
-            arVkCheck(VK_ERROR_INITIALIZATION_FAILED);
+            g.pendingEvent = xcb_wait_for_event(g.connection);
+        }
+#elif defined(AR_PLATFORM_WAYLAND)
+        if (!wl_display_prepare_read(g.display))
+        {
+            struct pollfd fd;
+            fd.fd = wl_display_get_fd(g.display);
+            fd.events = POLLIN;
+            wl_display_flush(g.display);
+
+            if (poll(&fd, 1, -1) > 0)
+            {
+                wl_display_read_events(g.display);
+            }
+            else
+            {
+                wl_display_cancel_read(g.display);
+            }
         }
+#endif
     }
+}
 
-    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo;
-    memoryAllocateFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-    memoryAllocateFlagsInfo.pNext = NULL;
-    memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-    memoryAllocateFlagsInfo.deviceMask = 0;
+void
+arWaitEvents(void)
+{
+    arWaitForEvent();
+    arPollEvents();
+}
+
+void
+arShowCursor(void)
+{
+#if defined(AR_PLATFORM_WIN32)
+    while (ShowCursor(true) < 0);
+#elif defined(AR_PLATFORM_XCB)
+    uint32_t cursor = XCB_CURSOR_NONE;
+    xcb_change_window_attributes(g.connection, g.window, XCB_CW_CURSOR, &cursor);
+    xcb_flush(g.connection);
+#elif defined(AR_PLATFORM_WAYLAND)
+    g.cursorHidden = false;
+    arWaylandApplyCursor();
+    wl_display_flush(g.display);
+#endif
+}
+
+void
+arHideCursor(void)
+{
+#if defined(AR_PLATFORM_WIN32)
+    while (ShowCursor(false) >= 0);
+#elif defined(AR_PLATFORM_XCB)
+    xcb_change_window_attributes(g.connection, g.window, XCB_CW_CURSOR, &g.hiddenCursor);
+    xcb_flush(g.connection);
+#elif defined(AR_PLATFORM_WAYLAND)
+    g.cursorHidden = true;
+    arWaylandApplyCursor();
+    wl_display_flush(g.display);
+#endif
+}
+
+void
+arSetCursorPosition(
+    int x,
+    int y)
+{
+#if defined(AR_PLATFORM_WIN32)
+    SetCursorPos(x, y);
+#elif defined(AR_PLATFORM_XCB)
+    xcb_warp_pointer(g.connection, XCB_NONE, g.screen->root, 0, 0, 0, 0, (int16_t)x, (int16_t)y);
+    xcb_flush(g.connection);
+#elif defined(AR_PLATFORM_WAYLAND)
+    // Clients cannot warp the pointer on Wayland.
+    (void)x;
+    (void)y;
+#endif
+}
+
+bool
+arIsKeyDown(
+    ArKey key)
+{
+    return(g.keys[key].isDown);
+}
+
+bool
+arIsKeyPressed(
+    ArKey key)
+{
+    return(g.keys[key].isPressed);
+}
+
+bool
+arIsKeyReleased(
+    ArKey key)
+{
+    return(g.keys[key].isReleased);
+}
 
-    VkMemoryAllocateInfo memoryAllocateInfo;
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
-    memoryAllocateInfo.memoryTypeIndex = typeIndex;
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    arVkCheck(g.vkAllocateMemory(g.device, &memoryAllocateInfo, NULL, (VkDeviceMemory*)&pBuffer->handle.data[1]));
-    arVkCheck(g.vkBindBufferMemory(g.device, pBuffer->handle.data[0], pBuffer->handle.data[1], 0));
+bool
+arIsButtonDown(
+    ArButton button)
+{
+    return(g.buttons[button].isDown);
+}
 
-    VkBufferDeviceAddressInfo addressInfo;
-    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-    addressInfo.pNext = NULL;
-    addressInfo.buffer = pBuffer->handle.data[0];
-    pBuffer->address = g.vkGetBufferDeviceAddress(g.device, &addressInfo);
+bool
+arIsButtonPressed(
+    ArButton button)
+{
+    return(g.buttons[button].isPressed);
 }
 
-void
-arCreateDynamicBuffer(
-    ArBuffer* pBuffer,
-    uint64_t capacity)
+bool
+arIsButtonReleased(
+    ArButton button)
 {
-    pBuffer->size = capacity;
-    arAllocBuffer(pBuffer, true);
-    arVkCheck(g.vkMapMemory(g.device, pBuffer->handle.data[1], 0, capacity, 0, &pBuffer->pMapped));
+    return(g.buttons[button].isReleased);
 }
 
-void
-arCreateStaticBuffer(
-    ArBuffer* pBuffer,
-    uint64_t size,
-    void const* pData)
+internal void
+arTimerCreate(void)
 {
-    pBuffer->size = size;
-    arAllocBuffer(pBuffer, false);
+#if defined(AR_PLATFORM_WIN32)
+    QueryPerformanceFrequency(&g.timeFrequency);
+    QueryPerformanceCounter(&g.timeOffset);
 
-    ArBuffer stagingBuffer;
-    arCreateDynamicBuffer(&stagingBuffer, size);
-    memcpy(stagingBuffer.pMapped, pData, size);
+    // High resolution timers need Windows 10 1803, older systems get a regular one.
+    g.frameTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
 
-    arBeginTransfer();
+    if (!g.frameTimer)
     {
-        VkBufferCopy region;
-        region.srcOffset = 0;
-        region.dstOffset = 0;
-        region.size = size;
-
-        g.vkCmdCopyBuffer(
-            g.transferCommandBuffer,
-            stagingBuffer.handle.data[0],
-            pBuffer->handle.data[0],
-            1,
-            &region);
+        g.frameTimer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
     }
-    arEndTransfer();
-
-    arDestroyBuffer(&stagingBuffer);
+#elif defined(AR_PLATFORM_POSIX)
+    clock_gettime(CLOCK_MONOTONIC, &g.timeOffset);
+#endif
 }
 
-void
-arDestroyBuffer(
-    ArBuffer const* pBuffer)
+internal void
+arTimerTeardown(void)
 {
-    if (pBuffer->pMapped)
+#if defined(AR_PLATFORM_WIN32)
+    if (g.frameTimer)
     {
-        g.vkUnmapMemory(g.device, pBuffer->handle.data[1]);
+        CloseHandle(g.frameTimer);
     }
-
-    g.vkFreeMemory(g.device, pBuffer->handle.data[1], NULL);
-    g.vkDestroyBuffer(g.device, pBuffer->handle.data[0], NULL);
+#endif
 }
 
-void
-arCreateImage(
-    ArImage* pImage,
-    ArImageCreateInfo const* pImageCreateInfo)
+internal void
+arPaceFrame(void)
 {
-    VkImageAspectFlags aspect = 0;
-    VkImageUsageFlags usage = 0;
-    VkFormat format = 0;
+    double period = 1.0 / g.targetFrameRate;
+    double now = arGetTime();
 
-    switch (pImageCreateInfo->usage)
+    // A frame that ran over starts a new schedule instead of rushing the following ones.
+    if (now - g.nextFrameTime > period)
     {
-    case AR_IMAGE_USAGE_COLOR_ATTACHMENT:
-        usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-        aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-        format = VK_FORMAT_B8G8R8A8_UNORM;
-        break;
-    case AR_IMAGE_USAGE_DEPTH_ATTACHMENT:
-        usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-        aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
-        format = VK_FORMAT_D32_SFLOAT;
-        break;
-    case AR_IMAGE_USAGE_TEXTURE:
-        usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-        aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-        format = (VkFormat)pImageCreateInfo->format;
-        break;
+        g.nextFrameTime = now + period;
+        return;
     }
 
-    if (pImageCreateInfo->sampler)
-    {
-        usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
-    }
+    // The OS sleep is cut short by a safety margin, the remainder is spun away.
+    double sleepTime = g.nextFrameTime - now - AR_FRAME_SPIN_TIME;
 
-    if (!pImageCreateInfo->depth)
-    {
-        pImage->depth = 1;
-    }
-    else
+    if (sleepTime > 0.0)
     {
-        pImage->depth = pImageCreateInfo->depth;
+#if defined(AR_PLATFORM_WIN32)
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -(long long)(sleepTime * 1e7);
+
+        if (g.frameTimer && SetWaitableTimer(g.frameTimer, &dueTime, 0, NULL, NULL, FALSE))
+        {
+            WaitForSingleObject(g.frameTimer, INFINITE);
+        }
+#elif defined(AR_PLATFORM_POSIX)
+        double wakeTime = g.nextFrameTime - AR_FRAME_SPIN_TIME;
+        long long nanoseconds = g.timeOffset.tv_nsec + (long long)((wakeTime - (long long)wakeTime) * 1e9);
+
+        struct timespec wake;
+        wake.tv_sec = g.timeOffset.tv_sec + (time_t)wakeTime + (time_t)(nanoseconds / 1000000000);
+        wake.tv_nsec = (long)(nanoseconds % 1000000000);
+
+        // Only interrupted sleeps are resumed, on any other error the spin below takes over.
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+        {
+        }
+#endif
     }
 
-    if (pImageCreateInfo->width && pImageCreateInfo->height)
+    while (arGetTime() < g.nextFrameTime)
     {
-        pImage->width  = pImageCreateInfo->width;
-        pImage->height = pImageCreateInfo->height;
     }
-    else
+
+    g.nextFrameTime += period;
+}
+
+double
+arGetTime(void)
+{
+    if (g.headless && g.headlessTimeStep > 0.0)
     {
-        pImage->width  = g.extent.width;
-        pImage->height = g.extent.height;
+        return(g.frameCounter * g.headlessTimeStep);
     }
 
-    VkImageCreateInfo imageCreateInfo;
-    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageCreateInfo.pNext = NULL;
-    imageCreateInfo.flags = 0;
-    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageCreateInfo.format = format;
-    imageCreateInfo.extent.width = pImage->width;
-    imageCreateInfo.extent.height = pImage->height;
-    imageCreateInfo.extent.depth = pImage->depth;
-    imageCreateInfo.mipLevels = 1;
-    imageCreateInfo.arrayLayers = 1;
-    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageCreateInfo.usage = usage;
-    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageCreateInfo.queueFamilyIndexCount = 0;
-    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    arVkCheck(g.vkCreateImage(g.device, &imageCreateInfo, NULL, (VkImage*)&pImage->handle.data[0]));
+#if defined(AR_PLATFORM_WIN32)
+    LARGE_INTEGER value;
+    QueryPerformanceCounter(&value);
 
-    VkMemoryRequirements memoryRequirements;
-    g.vkGetImageMemoryRequirements(g.device, pImage->handle.data[0], &memoryRequirements);
+    return((double)
+        (value.QuadPart - g.timeOffset.QuadPart)
+        / g.timeFrequency.QuadPart);
+#elif defined(AR_PLATFORM_POSIX)
+    struct timespec value;
+    clock_gettime(CLOCK_MONOTONIC, &value);
 
-    const VkMemoryPropertyFlags preferedFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    const VkMemoryPropertyFlags fallbackFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    return((double)(value.tv_sec - g.timeOffset.tv_sec)
+        + (value.tv_nsec - g.timeOffset.tv_nsec) * 1e-9);
+#endif
+}
 
-    uint32_t typeIndex = arFindMemoryType(memoryRequirements.memoryTypeBits, preferedFlags);
+double
+arGetDeltaTime(void)
+{
+    return(g.deltaTime);
+}
 
-    if (typeIndex == UINT32_MAX)
-    {
-        typeIndex = arFindMemoryType(memoryRequirements.memoryTypeBits, fallbackFlags);
+float
+arGetTimef(void)
+{
+    return((float)arGetTime());
+}
 
-        if (typeIndex == UINT32_MAX)
-        {
-            arVkCheck(VK_ERROR_INITIALIZATION_FAILED);
-        }
-    }
+float
+arGetDeltaTimef(void)
+{
+    return((float)g.deltaTime);
+}
 
-    VkMemoryAllocateInfo memoryAllocateInfo;
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.pNext = NULL;
-    memoryAllocateInfo.memoryTypeIndex = typeIndex;
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    arVkCheck(g.vkAllocateMemory(g.device, &memoryAllocateInfo, NULL, (VkDeviceMemory*)&pImage->handle.data[1]));
-    arVkCheck(g.vkBindImageMemory(g.device, pImage->handle.data[0], pImage->handle.data[1], 0));
+uint32_t
+arGetWindowWidth(void)
+{
+    return((uint32_t)g.width);
+}
 
-    VkImageViewCreateInfo imageViewCreateInfo;
-    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    imageViewCreateInfo.pNext = NULL;
-    imageViewCreateInfo.flags = 0;
-    imageViewCreateInfo.image = pImage->handle.data[0];
-    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    imageViewCreateInfo.format = format;
-    imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-    imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-    imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-    imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-    imageViewCreateInfo.subresourceRange.aspectMask = aspect;
-    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    imageViewCreateInfo.subresourceRange.levelCount = 1;
-    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-    imageViewCreateInfo.subresourceRange.layerCount = 1;
-    arVkCheck(g.vkCreateImageView(g.device, &imageViewCreateInfo, NULL, (VkImageView*)&pImage->handle.data[2]));
+uint32_t
+arGetWindowHeight(void)
+{
+    return((uint32_t)g.height);
+}
 
-    if (pImageCreateInfo->sampler)
-    {
-        VkDescriptorImageInfo descriptorImageInfo;
-        descriptorImageInfo.sampler = (&g.samplerLinearToEdge)[pImageCreateInfo->sampler - 1];
-        descriptorImageInfo.imageView = pImage->handle.data[2];
-        descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+uint32_t
+arGetRenderWidth(void)
+{
+    return(g.extent.width);
+}
+
+uint32_t
+arGetRenderHeight(void)
+{
+    return(g.extent.height);
+}
+
+#if defined(AR_PLATFORM_WIN32)
+int32_t
+arGetWindowPositionX(void)
+{
+    RECT point;
+    GetWindowRect(g.hwnd, &point);
+    return(point.left);
+}
+
+int32_t
+arGetWindowPositionY(void)
+{
+    RECT point;
+    GetWindowRect(g.hwnd, &point);
+    return(point.top);
+}
+#elif defined(AR_PLATFORM_XCB)
+internal xcb_translate_coordinates_reply_t*
+arXcbGetWindowPosition(void)
+{
+    return(xcb_translate_coordinates_reply(
+        g.connection,
+        xcb_translate_coordinates(g.connection, g.window, g.screen->root, 0, 0),
+        NULL));
+}
+
+int32_t
+arGetWindowPositionX(void)
+{
+    xcb_translate_coordinates_reply_t* reply = arXcbGetWindowPosition();
+    int32_t x = reply ? reply->dst_x : 0;
+    free(reply);
+    return(x);
+}
+
+int32_t
+arGetWindowPositionY(void)
+{
+    xcb_translate_coordinates_reply_t* reply = arXcbGetWindowPosition();
+    int32_t y = reply ? reply->dst_y : 0;
+    free(reply);
+    return(y);
+}
+#elif defined(AR_PLATFORM_WAYLAND)
+int32_t
+arGetWindowPositionX(void)
+{
+    return(0);
+}
+
+int32_t
+arGetWindowPositionY(void)
+{
+    return(0);
+}
+#endif
+
+float
+arGetWindowAspectRatio(void)
+{
+    return(g.width / (float)g.height);
+}
+
+float
+arGetRenderAspectRatio(void)
+{
+    return(g.extent.width / (float)g.extent.height);
+}
 
-        VkWriteDescriptorSet descriptorWrite;
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.pNext = NULL;
-        descriptorWrite.dstSet = g.descriptorSet;
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = pImageCreateInfo->dstArrayElement;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrite.pImageInfo = &descriptorImageInfo;
-        descriptorWrite.pBufferInfo = NULL;
-        descriptorWrite.pTexelBufferView = NULL;
-        g.vkUpdateDescriptorSets(g.device, 1, &descriptorWrite, 0, NULL);
-    }
+int
+arGetGlobalCursorX(void)
+{
+    return(g.globalCursorX);
 }
 
-void
-arUpdateImage(
-    ArImage* pImage,
-    size_t dataSize,
-    void const* pData)
+int
+arGetGlobalCursorY(void)
 {
-    ArBuffer stagingBuffer;
-    arCreateDynamicBuffer(&stagingBuffer, dataSize);
-    memcpy(stagingBuffer.pMapped, pData, dataSize);
+    return(g.globalCursorY);
+}
 
-    arBeginTransfer();
-    {
-        VkImageMemoryBarrier2 imageMemoryBarrier;
-        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-        imageMemoryBarrier.pNext = NULL;
-        imageMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-        imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_NONE;
-        imageMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarrier.image = pImage->handle.data[0];
-        imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-        imageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-        imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarrier.subresourceRange.layerCount = 1;
-
-        VkDependencyInfo dependencyInfo;
-        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-        dependencyInfo.pNext = NULL;
-        dependencyInfo.dependencyFlags = 0;
-        dependencyInfo.memoryBarrierCount = 0;
-        dependencyInfo.bufferMemoryBarrierCount = 0;
-        dependencyInfo.imageMemoryBarrierCount = 1;
-        dependencyInfo.pImageMemoryBarriers = &imageMemoryBarrier;
-        g.vkCmdPipelineBarrier2(g.transferCommandBuffer, &dependencyInfo);
+int
+arGetCursorX(void)
+{
+    return(g.cursorX);
+}
 
-        VkBufferImageCopy region;
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset.x = 0;
-        region.imageOffset.y = 0;
-        region.imageOffset.z = 0;
-        region.imageExtent.width  = pImage->width;
-        region.imageExtent.height = pImage->height;
-        region.imageExtent.depth  = pImage->depth;
-        g.vkCmdCopyBufferToImage(
-            g.transferCommandBuffer,
-            stagingBuffer.handle.data[0],
-            pImage->handle.data[0],
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1, &region);
+int
+arGetCursorY(void)
+{
+    return(g.cursorY);
+}
 
-        imageMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-        imageMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        g.vkCmdPipelineBarrier2(g.transferCommandBuffer, &dependencyInfo);
-    }
-    arEndTransfer();
+int
+arGetCursorDeltaX(void)
+{
+    return(g.cursorDeltaX);
+}
 
-    arDestroyBuffer(&stagingBuffer);
+int
+arGetCursorDeltaY(void)
+{
+    return(g.cursorDeltaY);
 }
 
-void
-arDestroyImage(
-    ArImage const* pImage)
+int
+arGetRelativeCursorX(void)
 {
-    g.vkDestroyImageView(g.device, pImage->handle.data[2], NULL);
-    g.vkFreeMemory(g.device, pImage->handle.data[1], NULL);
-    g.vkDestroyImage(g.device, pImage->handle.data[0], NULL);
+    return(g.cursorRelX);
 }
 
-void
-arCreateShaderFromFile(
-    ArShader* pShader,
-    char const* filename)
+int
+arGetRelativeCursorY(void)
 {
-    LARGE_INTEGER fileSize;
-    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    return(g.cursorRelY);
+}
 
-    if (file == INVALID_HANDLE_VALUE ||
-        !GetFileSizeEx(file, &fileSize))
-    {
-        arError("Failed to create file");
-    }
+internal int64_t
+arAtomicLoad(
+    int64_t volatile* pValue)
+{
+#if defined(_MSC_VER)
+    return(InterlockedCompareExchange64(pValue, 0, 0));
+#else
+    return(__atomic_load_n(pValue, __ATOMIC_SEQ_CST));
+#endif
+}
 
-    uint32_t* pBuffer = HeapAlloc(GetProcessHeap(), 0, fileSize.QuadPart);
-    DWORD bytesRead;
+internal void
+arAtomicStore(
+    int64_t volatile* pValue,
+    int64_t value)
+{
+#if defined(_MSC_VER)
+    InterlockedExchange64(pValue, value);
+#else
+    __atomic_store_n(pValue, value, __ATOMIC_SEQ_CST);
+#endif
+}
 
-    if (!pBuffer)
-    {
-        arError("Failed to allocate memory");
-    }
+internal int64_t
+arAtomicAdd(
+    int64_t volatile* pValue,
+    int64_t value)
+{
+#if defined(_MSC_VER)
+    return(InterlockedExchangeAdd64(pValue, value) + value);
+#else
+    return(__atomic_add_fetch(pValue, value, __ATOMIC_SEQ_CST));
+#endif
+}
 
-    if (!ReadFile(file, pBuffer, fileSize.LowPart, &bytesRead, NULL))
-    {
-        arError("Failed to read shader file");
-    }
+internal bool
+arAtomicCompareExchange(
+    int64_t volatile* pValue,
+    int64_t expected,
+    int64_t desired)
+{
+#if defined(_MSC_VER)
+    return(InterlockedCompareExchange64(pValue, desired, expected) == expected);
+#else
+    return(__atomic_compare_exchange_n(pValue, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+#endif
+}
 
-    CloseHandle(file);
-    arCreateShaderFromMemory(pShader, pBuffer, fileSize.QuadPart);
-    HeapFree(GetProcessHeap(), 0, pBuffer);
+internal void
+arJobYield(void)
+{
+#if defined(AR_PLATFORM_WIN32)
+    SwitchToThread();
+#elif defined(AR_PLATFORM_POSIX)
+    sched_yield();
+#endif
 }
 
-void
-arCreateShaderFromMemory(
-    ArShader* pShader,
-    uint32_t const* pCode,
-    size_t codeSize)
+internal uint32_t
+arJobThreadIndex(void)
 {
-    VkShaderModuleCreateInfo shaderModuleCreateInfo;
-    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderModuleCreateInfo.pNext = NULL;
-    shaderModuleCreateInfo.flags = 0;
-    shaderModuleCreateInfo.codeSize = codeSize;
-    shaderModuleCreateInfo.pCode = pCode;
-    arVkCheck(g.vkCreateShaderModule(g.device, &shaderModuleCreateInfo, NULL, (VkShaderModule*)pShader));
+#if defined(AR_PLATFORM_WIN32)
+    uintptr_t index = (uintptr_t)TlsGetValue(g.jobThreadKey);
+#elif defined(AR_PLATFORM_POSIX)
+    uintptr_t index = (uintptr_t)pthread_getspecific(g.jobThreadKey);
+#endif
+
+    // Zero means the thread is not owned by arline and has no queue of its own.
+    return((uint32_t)index - 1);
 }
 
-void
-arDestroyShader(
-    ArShader const* pShader)
+internal void
+arJobSetThreadIndex(
+    uint32_t index)
 {
-    g.vkDestroyShaderModule(g.device, pShader->handle.data, NULL);
+#if defined(AR_PLATFORM_WIN32)
+    TlsSetValue(g.jobThreadKey, (void*)(uintptr_t)(index + 1));
+#elif defined(AR_PLATFORM_POSIX)
+    pthread_setspecific(g.jobThreadKey, (void*)(uintptr_t)(index + 1));
+#endif
 }
 
-void
-arCreateGraphicsPipeline(
-    ArPipeline* pPipeline,
-    ArGraphicsPipelineCreateInfo const* pPipelineCreateInfo)
+internal bool
+arJobPush(
+    ArJobQueue* pQueue,
+    ArJob const* pJob)
 {
-    VkFormat colorFormats[8];
-    colorFormats[0] = VK_FORMAT_B8G8R8A8_UNORM;
-    colorFormats[1] = VK_FORMAT_B8G8R8A8_UNORM;
-    colorFormats[2] = VK_FORMAT_B8G8R8A8_UNORM;
-    colorFormats[3] = VK_FORMAT_B8G8R8A8_UNORM;
-    colorFormats[4] = VK_FORMAT_B8G8R8A8_UNORM;
-    colorFormats[5] = VK_FORMAT_B8G8R8A8_UNORM;
-    colorFormats[6] = VK_FORMAT_B8G8R8A8_UNORM;
-    colorFormats[7] = VK_FORMAT_B8G8R8A8_UNORM;
+    int64_t bottom = arAtomicLoad(&pQueue->bottom);
+    int64_t top = arAtomicLoad(&pQueue->top);
 
-    VkPipelineColorBlendAttachmentState blendAttachments[8];
-    for (uint32_t i = pPipelineCreateInfo->blendAttachmentCount; i--; )
+    if (bottom - top >= AR_JOB_QUEUE_SIZE)
     {
-        blendAttachments[i].blendEnable         = pPipelineCreateInfo->pBlendAttachments[i].blendEnable;
-        blendAttachments[i].srcColorBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].srcColorFactor;
-        blendAttachments[i].dstColorBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].dstColorFactor;
-        blendAttachments[i].colorBlendOp        = (VkBlendOp)pPipelineCreateInfo->pBlendAttachments[i].colorBlendOp;
-        blendAttachments[i].srcAlphaBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].srcAlphaFactor;
-        blendAttachments[i].dstAlphaBlendFactor = (VkBlendFactor)pPipelineCreateInfo->pBlendAttachments[i].dstAlphaFactor;
-        blendAttachments[i].alphaBlendOp        = (VkBlendOp)pPipelineCreateInfo->pBlendAttachments[i].alphaBlendOp;
-        blendAttachments[i].colorWriteMask      = pPipelineCreateInfo->pBlendAttachments[i].colorWriteMask;
+        return(false);
     }
 
-    VkPipelineRenderingCreateInfo renderingCreateInfo;
-    renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
-    renderingCreateInfo.pNext = NULL;
-    renderingCreateInfo.viewMask = 0;
-    renderingCreateInfo.colorAttachmentCount = pPipelineCreateInfo->blendAttachmentCount;
-    renderingCreateInfo.pColorAttachmentFormats = colorFormats;
-    renderingCreateInfo.depthAttachmentFormat = VK_FORMAT_D32_SFLOAT;
-    renderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+    pQueue->jobs[bottom & (AR_JOB_QUEUE_SIZE - 1)] = *pJob;
+    arAtomicStore(&pQueue->bottom, bottom + 1);
 
-    VkPipelineShaderStageCreateInfo shaderStages[2];
-    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[0].pNext = NULL;
-    shaderStages[0].flags = 0;
-    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = pPipelineCreateInfo->vertShader.handle.data;
-    shaderStages[0].pName = "main";
-    shaderStages[0].pSpecializationInfo = NULL;
+    return(true);
+}
 
-    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[1].pNext = NULL;
-    shaderStages[1].flags = 0;
-    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = pPipelineCreateInfo->fragShader.handle.data;
-    shaderStages[1].pName = "main";
-    shaderStages[1].pSpecializationInfo = NULL;
+internal bool
+arJobPop(
+    ArJobQueue* pQueue,
+    ArJob* pJob)
+{
+    int64_t bottom = arAtomicLoad(&pQueue->bottom) - 1;
+    arAtomicStore(&pQueue->bottom, bottom);
+    int64_t top = arAtomicLoad(&pQueue->top);
 
-    VkPipelineVertexInputStateCreateInfo vertexInputState;
-    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputState.pNext = NULL;
-    vertexInputState.flags = 0;
-    vertexInputState.vertexBindingDescriptionCount = 0;
-    vertexInputState.vertexAttributeDescriptionCount = 0;
+    if (top > bottom)
+    {
+        arAtomicStore(&pQueue->bottom, bottom + 1);
+        return(false);
+    }
 
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
-    inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyState.pNext = NULL;
-    inputAssemblyState.flags = 0;
-    inputAssemblyState.primitiveRestartEnable = false;
-    inputAssemblyState.topology = (VkPrimitiveTopology)pPipelineCreateInfo->topology;
+    *pJob = pQueue->jobs[bottom & (AR_JOB_QUEUE_SIZE - 1)];
 
-    VkPipelineViewportStateCreateInfo viewportState;
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.pNext = NULL;
-    viewportState.flags = 0;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = NULL;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = NULL;
+    if (top == bottom)
+    {
+        // The last job may be contended by a thief, whoever moves the top first owns it.
+        bool won = arAtomicCompareExchange(&pQueue->top, top, top + 1);
+        arAtomicStore(&pQueue->bottom, bottom + 1);
 
-    VkPipelineRasterizationStateCreateInfo rasterizationState;
-    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizationState.pNext = NULL;
-    rasterizationState.flags = 0;
-    rasterizationState.depthClampEnable = false;
-    rasterizationState.rasterizerDiscardEnable = false;
-    rasterizationState.polygonMode = (VkPolygonMode)pPipelineCreateInfo->polygonMode;
-    rasterizationState.cullMode = pPipelineCreateInfo->cullMode;
-    rasterizationState.frontFace = (VkFrontFace)pPipelineCreateInfo->frontFace;
-    rasterizationState.depthBiasEnable = false;
-    rasterizationState.lineWidth = 1.0f;
-    rasterizationState.depthBiasClamp = 0.0f;
+        return(won);
+    }
 
-    VkPipelineMultisampleStateCreateInfo multisampleState;
-    multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleState.pNext = NULL;
-    multisampleState.flags = 0;
-    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleState.sampleShadingEnable = false;
-    multisampleState.pSampleMask = NULL;
-    multisampleState.alphaToCoverageEnable = false;
-    multisampleState.alphaToOneEnable = false;
+    return(true);
+}
 
-    VkPipelineDepthStencilStateCreateInfo depthStencilState;
-    depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencilState.pNext = NULL;
-    depthStencilState.flags = 0;
-    depthStencilState.stencilTestEnable = false;
-    depthStencilState.depthBoundsTestEnable = false;
-    depthStencilState.depthWriteEnable = pPipelineCreateInfo->depthState.depthWriteEnable;
-    depthStencilState.depthTestEnable = pPipelineCreateInfo->depthState.depthTestEnable;
-    depthStencilState.depthCompareOp = (VkCompareOp)pPipelineCreateInfo->depthState.compareOp;
-    depthStencilState.front.failOp = VK_STENCIL_OP_KEEP;
-    depthStencilState.front.passOp = VK_STENCIL_OP_KEEP;
-    depthStencilState.front.depthFailOp = VK_STENCIL_OP_KEEP;
-    depthStencilState.front.compareOp = VK_COMPARE_OP_NEVER;
-    depthStencilState.front.compareMask = 0;
-    depthStencilState.front.writeMask = 0;
-    depthStencilState.front.reference = 0;
-    depthStencilState.back.failOp = VK_STENCIL_OP_KEEP;
-    depthStencilState.back.passOp = VK_STENCIL_OP_KEEP;
-    depthStencilState.back.depthFailOp = VK_STENCIL_OP_KEEP;
-    depthStencilState.back.compareOp = VK_COMPARE_OP_NEVER;
-    depthStencilState.back.compareMask = 0;
-    depthStencilState.back.writeMask = 0;
-    depthStencilState.back.reference = 0;
+internal bool
+arJobSteal(
+    ArJobQueue* pQueue,
+    ArJob* pJob)
+{
+    int64_t top = arAtomicLoad(&pQueue->top);
+    int64_t bottom = arAtomicLoad(&pQueue->bottom);
+
+    if (top >= bottom)
+    {
+        return(false);
+    }
+
+    // The owner may be reusing this slot if the top moved meanwhile, the failed exchange then discards the copy.
+    *pJob = pQueue->jobs[top & (AR_JOB_QUEUE_SIZE - 1)];
+
+    return(arAtomicCompareExchange(&pQueue->top, top, top + 1));
+}
+
+internal bool
+arJobFind(
+    uint32_t threadIndex,
+    ArJob* pJob)
+{
+    bool found = false;
+
+    if (threadIndex < g.jobThreadCount)
+    {
+        found = arJobPop(&g.pJobQueues[threadIndex], pJob);
+    }
 
-    VkPipelineColorBlendStateCreateInfo colorBlendState;
-    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendState.pNext = NULL;
-    colorBlendState.flags = 0;
-    colorBlendState.logicOpEnable = false;
-    colorBlendState.logicOp = VK_LOGIC_OP_COPY;
-    colorBlendState.attachmentCount = pPipelineCreateInfo->blendAttachmentCount;
-    colorBlendState.pAttachments = blendAttachments;
+    for (uint32_t i = 1; !found && i <= g.jobThreadCount; ++i)
+    {
+        found = arJobSteal(&g.pJobQueues[(threadIndex + i) % g.jobThreadCount], pJob);
+    }
 
-    VkDynamicState dynamicStates[2];
-    dynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
-    dynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+    if (found)
+    {
+        arAtomicAdd(&g.jobQueued, -1);
+    }
 
-    VkPipelineDynamicStateCreateInfo dynamicState;
-    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.pNext = NULL;
-    dynamicState.flags = 0;
-    dynamicState.dynamicStateCount = 2;
-    dynamicState.pDynamicStates = dynamicStates;
+    return(found);
+}
 
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo;
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.pNext = &renderingCreateInfo;
-    pipelineCreateInfo.flags = 0;
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertexInputState;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-    pipelineCreateInfo.pTessellationState = NULL;
-    pipelineCreateInfo.pViewportState = &viewportState;
-    pipelineCreateInfo.pRasterizationState = &rasterizationState;
-    pipelineCreateInfo.pMultisampleState = &multisampleState;
-    pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-    pipelineCreateInfo.pColorBlendState = &colorBlendState;
-    pipelineCreateInfo.pDynamicState = &dynamicState;
-    pipelineCreateInfo.layout = g.pipelineLayout;
-    pipelineCreateInfo.renderPass = NULL;
-    arVkCheck(g.vkCreateGraphicsPipelines(g.device, NULL, 1, &pipelineCreateInfo, NULL, (VkPipeline*)pPipeline));
+internal void
+arJobRun(
+    ArJob const* pJob)
+{
+    if (pJob->pfnRange)
+    {
+        pJob->pfnRange(pJob->pData, pJob->begin, pJob->end);
+    }
+    else
+    {
+        pJob->pfnJob(pJob->pData);
+    }
+
+    if (pJob->pCounter)
+    {
+        arAtomicAdd(&pJob->pCounter->value, -1);
+    }
 }
 
-void
-arDestroyPipeline(
-    ArPipeline const* pPipeline)
+internal void
+arJobEnqueue(
+    ArJob const* pJob)
 {
-    g.vkDestroyPipeline(g.device, pPipeline->handle.data, NULL);
+    if (pJob->pCounter)
+    {
+        arAtomicAdd(&pJob->pCounter->value, 1);
+    }
+
+    uint32_t threadIndex = arJobThreadIndex();
+
+    if (threadIndex >= g.jobThreadCount)
+    {
+        arError("Jobs can only be submitted from the main thread or from a job");
+    }
+
+    // Without workers, or with a full queue, the job simply runs on the submitting thread.
+    arAtomicAdd(&g.jobQueued, 1);
+
+    if (g.jobThreadCount == 1 || !arJobPush(&g.pJobQueues[threadIndex], pJob))
+    {
+        arAtomicAdd(&g.jobQueued, -1);
+        arJobRun(pJob);
+        return;
+    }
+
+    for (int64_t sleepers = arAtomicLoad(&g.jobSleepers); sleepers > 0; sleepers = arAtomicLoad(&g.jobSleepers))
+    {
+        if (arAtomicCompareExchange(&g.jobSleepers, sleepers, sleepers - 1))
+        {
+#if defined(AR_PLATFORM_WIN32)
+            ReleaseSemaphore(g.jobSemaphore, 1, NULL);
+#elif defined(AR_PLATFORM_POSIX)
+            sem_post(&g.jobSemaphore);
+#endif
+            break;
+        }
+    }
 }
 
-void
-arCmdBeginRendering(
-    uint32_t colorAttachmentCount,
-    ArAttachment const* pColorAttachments,
-    ArAttachment const* pDepthAttachment)
+internal void
+arJobSleep(void)
 {
-    VkRenderingAttachmentInfo attachments[8];
-    VkRenderingAttachmentInfo depthAttachment;
+    arAtomicAdd(&g.jobSleepers, 1);
 
-    if (pDepthAttachment)
+    // A job queued after the last search must not be slept through. If a submitter already
+    // claimed this sleeper its wake-up is on the way and has to be consumed.
+    if (arAtomicLoad(&g.jobQueued) > 0 || arAtomicLoad(&g.jobQuit))
     {
-        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-        depthAttachment.pNext = NULL;
-        depthAttachment.imageView = pDepthAttachment->pImage->handle.data[2];
-        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-        depthAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
-        depthAttachment.resolveImageView = NULL;
-        depthAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthAttachment.loadOp = (VkAttachmentLoadOp)pDepthAttachment->loadOp;
-        depthAttachment.storeOp = (VkAttachmentStoreOp)pDepthAttachment->storeOp;
-        depthAttachment.clearValue.depthStencil.depth = pDepthAttachment->clearValue.depth;
-        depthAttachment.clearValue.depthStencil.stencil = 0;
+        for (int64_t sleepers = arAtomicLoad(&g.jobSleepers); sleepers > 0; sleepers = arAtomicLoad(&g.jobSleepers))
+        {
+            if (arAtomicCompareExchange(&g.jobSleepers, sleepers, sleepers - 1))
+            {
+                return;
+            }
+        }
     }
 
-    for (uint32_t i = 0; i < colorAttachmentCount; ++i)
+#if defined(AR_PLATFORM_WIN32)
+    WaitForSingleObject(g.jobSemaphore, INFINITE);
+#elif defined(AR_PLATFORM_POSIX)
+    while (sem_wait(&g.jobSemaphore))
     {
-        if (!pColorAttachments[i].pImage)
+    }
+#endif
+}
+
+internal void
+arJobWorker(
+    uint32_t threadIndex)
+{
+    arJobSetThreadIndex(threadIndex);
+
+    for (uint32_t spin = 0;; )
+    {
+        ArJob job;
+
+        if (arJobFind(threadIndex, &job))
+        {
+            arJobRun(&job);
+            spin = 0;
+        }
+        else if (arAtomicLoad(&g.jobQuit))
         {
-            attachments[i].imageView = g.pFrame->view;
+            break;
+        }
+        else if (++spin < AR_JOB_SPIN_COUNT)
+        {
+            arJobYield();
         }
         else
         {
-            attachments[i].imageView = pColorAttachments[i].pImage->handle.data[2];
+            arJobSleep();
+            spin = 0;
         }
+    }
+}
+
+#if defined(AR_PLATFORM_WIN32)
+internal DWORD WINAPI
+arJobThreadProc(
+    LPVOID pParameter)
+{
+    arJobWorker((uint32_t)(uintptr_t)pParameter);
+    return(0);
+}
+#elif defined(AR_PLATFORM_POSIX)
+internal void*
+arJobThreadProc(
+    void* pParameter)
+{
+    arJobWorker((uint32_t)(uintptr_t)pParameter);
+    return(NULL);
+}
+#endif
 
-        attachments[i].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-        attachments[i].pNext = NULL;
-        attachments[i].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        attachments[i].resolveMode = VK_RESOLVE_MODE_NONE;
-        attachments[i].resolveImageView = NULL;
-        attachments[i].resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        attachments[i].loadOp = (VkAttachmentLoadOp)pColorAttachments[i].loadOp;
-        attachments[i].storeOp = (VkAttachmentStoreOp)pColorAttachments[i].storeOp;
-        attachments[i].clearValue.color.int32[0] = pColorAttachments[i].clearValue.color.int32[0];
-        attachments[i].clearValue.color.int32[1] = pColorAttachments[i].clearValue.color.int32[1];
-        attachments[i].clearValue.color.int32[2] = pColorAttachments[i].clearValue.color.int32[2];
-        attachments[i].clearValue.color.int32[3] = pColorAttachments[i].clearValue.color.int32[3];
+internal void
+arWaitLatency(void)
+{
+    uint64_t frame = g.frameCounter;
+    bool presented = false;
+
+    // Input is sampled only once the previous frame is on screen, or at least off the GPU, so the
+    // next frame starts with an empty queue instead of behind a full frame of queued work.
+    if (g.presentWait && !g.headless && g.presentIdSwapchain == g.swapchain && g.presentIdValue == frame)
+    {
+        presented = g.vkWaitForPresentKHR(g.device, g.swapchain, frame, AR_PRESENT_WAIT_TIMEOUT) == VK_SUCCESS;
     }
 
-    VkExtent2D extent;
-    if (pColorAttachments->pImage)
+    if (!presented)
     {
-        extent.width  = pColorAttachments->pImage->width;
-        extent.height = pColorAttachments->pImage->height;
+        arWaitFrame(frame);
     }
-    else
+
+    double latency = arGetTime() - g.inputTimes[(frame - 1) % g.framesInFlight];
+    g.frameLatency = g.frameLatency > 0.0 ? g.frameLatency * 0.9 + latency * 0.1 : latency;
+}
+
+internal void
+arJobsCreate(
+    uint32_t threadCount)
+{
+    if (!threadCount)
     {
-        extent.width  = g.extent.width;
-        extent.height = g.extent.height;
-    }
-
-    VkRenderingInfo renderingInfo;
-    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-    renderingInfo.pNext = NULL;
-    renderingInfo.flags = 0;
-    renderingInfo.renderArea.offset.x = 0;
-    renderingInfo.renderArea.offset.y = 0;
-    renderingInfo.renderArea.extent.width  = extent.width;
-    renderingInfo.renderArea.extent.height = extent.height;
-    renderingInfo.layerCount = 1;
-    renderingInfo.viewMask = 0;
-    renderingInfo.colorAttachmentCount = colorAttachmentCount;
-    renderingInfo.pColorAttachments = attachments;
-    renderingInfo.pDepthAttachment = pDepthAttachment ? &depthAttachment : NULL;
-    renderingInfo.pStencilAttachment = NULL;
-    g.vkCmdBeginRendering(g.pFrame->cmd, &renderingInfo);
+#if defined(AR_PLATFORM_WIN32)
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        threadCount = systemInfo.dwNumberOfProcessors;
+#elif defined(AR_PLATFORM_POSIX)
+        long processorCount = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processorCount > 0 ? (uint32_t)processorCount : 1;
+#endif
+    }
 
-    VkRect2D scissor;
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent.width  = extent.width;
-    scissor.extent.height = extent.height;
-    g.vkCmdSetScissor(g.pFrame->cmd, 0, 1, &scissor);
+    g.jobThreadCount = min(threadCount, AR_MAX_JOB_THREADS);
+    g.jobQueued = 0;
+    g.jobSleepers = 0;
+    g.jobQuit = 0;
+    g.pJobQueues = arHostAlloc(g.jobThreadCount * sizeof(ArJobQueue));
 
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width  = (float)extent.width;
-    viewport.height = (float)extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    g.vkCmdSetViewport(g.pFrame->cmd, 0, 1, &viewport);
+    for (uint32_t i = g.jobThreadCount; i--; )
+    {
+        g.pJobQueues[i].top = 0;
+        g.pJobQueues[i].bottom = 0;
+    }
+
+#if defined(AR_PLATFORM_WIN32)
+    g.jobThreadKey = TlsAlloc();
+    g.jobSemaphore = CreateSemaphoreA(NULL, 0, AR_MAX_JOB_THREADS, NULL);
+
+    if (g.jobThreadKey == TLS_OUT_OF_INDEXES || !g.jobSemaphore)
+    {
+        arError("Failed to create job system");
+    }
+#elif defined(AR_PLATFORM_POSIX)
+    if (pthread_key_create(&g.jobThreadKey, NULL) || sem_init(&g.jobSemaphore, 0, 0))
+    {
+        arError("Failed to create job system");
+    }
+#endif
+
+    // The calling thread takes part as thread 0, the rest are workers.
+    arJobSetThreadIndex(0);
+
+    for (uint32_t i = 1; i < g.jobThreadCount; ++i)
+    {
+#if defined(AR_PLATFORM_WIN32)
+        g.jobThreads[i] = CreateThread(NULL, 0, arJobThreadProc, (LPVOID)(uintptr_t)i, 0, NULL);
+
+        if (!g.jobThreads[i])
+#elif defined(AR_PLATFORM_POSIX)
+        if (pthread_create(&g.jobThreads[i], NULL, arJobThreadProc, (void*)(uintptr_t)i))
+#endif
+        {
+            arError("Failed to create job thread");
+        }
+    }
 }
 
-void
-arCmdEndRendering(void)
+internal void
+arJobsTeardown(void)
 {
-    g.vkCmdEndRendering(g.pFrame->cmd);
+    arAtomicStore(&g.jobQuit, 1);
+
+    for (uint32_t i = g.jobThreadCount; --i; )
+    {
+#if defined(AR_PLATFORM_WIN32)
+        ReleaseSemaphore(g.jobSemaphore, 1, NULL);
+#elif defined(AR_PLATFORM_POSIX)
+        sem_post(&g.jobSemaphore);
+#endif
+    }
+
+    for (uint32_t i = g.jobThreadCount; --i; )
+    {
+#if defined(AR_PLATFORM_WIN32)
+        WaitForSingleObject(g.jobThreads[i], INFINITE);
+        CloseHandle(g.jobThreads[i]);
+#elif defined(AR_PLATFORM_POSIX)
+        pthread_join(g.jobThreads[i], NULL);
+#endif
+    }
+
+    // Fire-and-forget jobs left on the main thread's queue still get to run.
+    for (ArJob job; arJobPop(&g.pJobQueues[0], &job); )
+    {
+        arJobRun(&job);
+    }
+
+#if defined(AR_PLATFORM_WIN32)
+    CloseHandle(g.jobSemaphore);
+    TlsFree(g.jobThreadKey);
+#elif defined(AR_PLATFORM_POSIX)
+    sem_destroy(&g.jobSemaphore);
+    pthread_key_delete(g.jobThreadKey);
+#endif
+    arHostFree(g.pJobQueues);
+    g.pJobQueues = NULL;
+    g.jobThreadCount = 0;
 }
 
 void
-arCmdPushConstants(
-    uint32_t offset,
-    uint32_t size,
-    void const* pValues)
+arExecute(
+    ArApplicationInfo const* pApplicationInfo)
 {
-    g.vkCmdPushConstants(
-        g.pFrame->cmd,
-        g.pipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT,
-        offset,
-        size,
-        pValues);
-}
+    g.pfnUpdate = pApplicationInfo->pfnUpdate;
+    g.pfnResize = pApplicationInfo->pfnResize;
+    g.pfnRecordCommands = pApplicationInfo->pfnRecordCommands;
+    g.vsyncEnabled = pApplicationInfo->enableVsync;
+    g.presentModeRequest = pApplicationInfo->presentMode;
+    g.swapchainImageCount = pApplicationInfo->swapchainImageCount;
+
+    if (g.presentModeRequest != AR_PRESENT_MODE_DEFAULT)
+    {
+        g.vsyncEnabled = g.presentModeRequest == AR_PRESENT_MODE_FIFO || g.presentModeRequest == AR_PRESENT_MODE_FIFO_RELAXED;
+    }
+    g.framesInFlight = pApplicationInfo->framesInFlight ? pApplicationInfo->framesInFlight : 2;
+    g.framesInFlight = g.framesInFlight < AR_MAX_FRAMES_IN_FLIGHT ? g.framesInFlight : AR_MAX_FRAMES_IN_FLIGHT;
+    g.transientSize = pApplicationInfo->transientMemorySize ? pApplicationInfo->transientMemorySize : AR_DEFAULT_TRANSIENT_MEMORY_SIZE;
+    g.transientSize = (g.transientSize + 255) & ~(uint64_t)255;
+    g.headless = pApplicationInfo->headless;
+    g.immediateRecording = pApplicationInfo->immediateRecording;
+    g.lowLatency = pApplicationInfo->lowLatency;
+    g.targetFrameRate = pApplicationInfo->targetFrameRate;
+    g.onDemandRendering = pApplicationInfo->onDemandRendering;
+    g.redrawRequested = true;
+    g.headlessTimeStep = pApplicationInfo->headlessTimeStep;
+    arTimerCreate();
+    arJobsCreate(pApplicationInfo->jobThreadCount);
+
+    if (g.headless)
+    {
+        g.width  = pApplicationInfo->width;
+        g.height = pApplicationInfo->height;
+    }
+    else
+    {
+        arWindowCreate(pApplicationInfo->width, pApplicationInfo->height);
+    }
+
+    arContextCreate();
+
+    pApplicationInfo->pfnInit();
+    arRecordCommands(); 
+
+    for (;;)
+    {
+        if (g.headless &&
+            pApplicationInfo->headlessFrameCount &&
+            g.frameCounter == pApplicationInfo->headlessFrameCount)
+        {
+            break;
+        }
+
+        // A hidden window acquires and renders nothing, the thread sleeps until it is shown again.
+        if (!g.headless && g.suspended)
+        {
+            arWaitEvents();
+
+            if (g.windowShouldClose)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        // Without a pending redraw the loop idles until the next event gives the application a reason to draw.
+        if (!g.headless && g.onDemandRendering && !g.redrawRequested && !g.swapchainDirty)
+        {
+            arWaitForEvent();
+        }
+
+#if defined(AR_PLATFORM_WAYLAND)
+        if (!g.headless && g.vsyncEnabled)
+        {
+            arWaylandWaitFrame();
+        }
+#endif
+
+        // Once the slot's previous frame retired its transient memory can be handed out again.
+        g.frameIndex = (uint32_t)(g.frameCounter % g.framesInFlight);
+        g.transientOffset = 0;
+
+        if (g.frameCounter >= g.framesInFlight)
+        {
+            arWaitFrame(g.frameCounter + 1 - g.framesInFlight);
+        }
+
+        if (g.lowLatency && g.frameCounter)
+        {
+            arWaitLatency();
+        }
+
+        if (!g.headless && g.targetFrameRate > 0.0)
+        {
+            arPaceFrame();
+        }
+
+        g.inputTimes[g.frameIndex] = arGetTime();
+        pApplicationInfo->pfnUpdate();
+
+        if (g.windowShouldClose)
+        {
+            break;
+        }
+
+        switch (pApplicationInfo->pfnUpdateResources())
+        {
+        case AR_REQUEST_NONE:
+            break;
+        case AR_REQUEST_RECORD_COMMANDS:
+            arRecordCommands();
+            break;
+        case AR_REQUEST_VSYNC_DISABLE:
+            g.vsyncEnabled = false;
+            arSetPresentMode(AR_PRESENT_MODE_DEFAULT);
+            break;
+        case AR_REQUEST_VSYNC_ENABLE:
+            g.vsyncEnabled = true;
+            arSetPresentMode(AR_PRESENT_MODE_DEFAULT);
+            break;
+        }
+
+        // Every resize and present mode change since the last frame is folded into one recreation.
+        if (!g.headless && g.swapchainDirty)
+        {
+            arSwapchainRecreate(g.vsyncEnabled);
+        }
+
+        if (g.retiredSwapchainCount)
+        {
+            uint64_t completed;
+            arVkCheck(g.vkGetSemaphoreCounterValue(g.device, g.timeline, &completed));
+            arSwapchainCollect(completed);
+        }
+
+        if (g.deferredCount)
+        {
+            uint64_t completedFrame;
+            uint64_t completedUpload;
+            arVkCheck(g.vkGetSemaphoreCounterValue(g.device, g.timeline, &completedFrame));
+            arVkCheck(g.vkGetSemaphoreCounterValue(g.device, g.uploadTimeline, &completedUpload));
+            arDeferredCollect(completedFrame, completedUpload);
+        }
+
+        if (!g.headless && g.onDemandRendering && !g.redrawRequested)
+        {
+            continue;
+        }
+
+        if (g.headless)
+        {
+            g.imageIndex = (uint32_t)(g.frameCounter % g.imageCount);
+        }
+        else
+        {
+            g.acqSemaphore.semaphore = g.acqSemaphores[g.frameIndex];
 
-void
-arCmdBindIndexBuffer(
-    ArBuffer const* pBuffer,
-    uint64_t offset,
-    ArIndexType indexType)
-{
-    g.vkCmdBindIndexBuffer(
-        g.pFrame->cmd,
-        *pBuffer->handle.data,
-        offset,
-        (VkIndexType)indexType);
-}
+            VkResult result = g.vkAcquireNextImageKHR(g.device, g.swapchain, UINT64_MAX, g.acqSemaphore.semaphore, NULL, &g.imageIndex);
 
-void
-arCmdBindGraphicsPipeline(
-    ArPipeline const* pPipeline)
-{
-    g.vkCmdBindPipeline(
-        g.pFrame->cmd,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        pPipeline->handle.data);
-}
+            // An out-of-date chain acquired nothing, the frame is dropped and the chain rebuilt before the next one.
+            // A suboptimal one still delivered an image, so the frame goes ahead and is rebuilt afterwards.
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                g.swapchainDirty = true;
+                g.skippedFrameCount += 1;
+                continue;
+            }
+            else if (result == VK_SUBOPTIMAL_KHR)
+            {
+                g.swapchainDirty = true;
+                g.suboptimalFrameCount += 1;
+            }
+            else if (result)
+            {
+                arError("Failed to acquire image");
+            }
 
-internal VkPipelineStageFlags2
-arImageLayoutToPipelineStage(
-    ArImageLayout layout)
-{
-    switch (layout)
-    {
-    case AR_IMAGE_LAYOUT_COLOR_ATTACHMENT:
-        return(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT); 
-    case AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT:
-        return(VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
-               VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT);
-    case AR_IMAGE_LAYOUT_SHADER_READ:
-        return(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
-    case AR_IMAGE_LAYOUT_TRANSFER_SRC:
-    case AR_IMAGE_LAYOUT_TRANSFER_DST:
-        return(VK_PIPELINE_STAGE_2_TRANSFER_BIT);
-    case AR_IMAGE_LAYOUT_PRESENT_SRC:
-        return(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
-    default:
-        return(VK_PIPELINE_STAGE_2_NONE);
-    }
-}
+            g.redrawRequested = false;
+        }
 
-internal VkAccessFlags2
-arImageLayoutToAccess(
-    ArImageLayout layout)
-{
-    switch (layout)
-    {
-    case AR_IMAGE_LAYOUT_COLOR_ATTACHMENT:
-        return(VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT); 
-    case AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT:
-        return(VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
-    case AR_IMAGE_LAYOUT_SHADER_READ:
-        return(VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
-    case AR_IMAGE_LAYOUT_TRANSFER_SRC:
-        return(VK_ACCESS_2_TRANSFER_READ_BIT);
-    case AR_IMAGE_LAYOUT_TRANSFER_DST:
-        return(VK_ACCESS_2_TRANSFER_WRITE_BIT);
-    default:
-        return(VK_ACCESS_2_NONE);
-    }
-}
+        // Uploads that finished since the last frame are handed over to the graphics queue.
+        if (g.acquireCounter < g.uploadCounter)
+        {
+            uint64_t completed;
+            arVkCheck(g.vkGetSemaphoreCounterValue(g.device, g.uploadTimeline, &completed));
+            arFlushAcquires(completed);
+        }
 
-void
-arCmdPipelineBarrier(
-    uint32_t barrierCount,
-    ArBarrier const* pBarriers)
-{
-    VkImageMemoryBarrier2 imageMemoryBarriers[8];
+        ArFrame* pFrame = &g.frames[g.imageIndex];
 
-    for (uint32_t i = 0; i < barrierCount; ++i)
-    {
-        imageMemoryBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-        imageMemoryBarriers[i].pNext = NULL;
-        imageMemoryBarriers[i].srcStageMask = arImageLayoutToPipelineStage(pBarriers[i].oldLayout);
-        imageMemoryBarriers[i].srcAccessMask = arImageLayoutToAccess(pBarriers[i].oldLayout);
-        imageMemoryBarriers[i].dstStageMask = arImageLayoutToPipelineStage(pBarriers[i].newLayout);
-        imageMemoryBarriers[i].dstAccessMask = arImageLayoutToAccess(pBarriers[i].newLayout);
-        imageMemoryBarriers[i].oldLayout = (VkImageLayout)pBarriers[i].oldLayout;
-        imageMemoryBarriers[i].newLayout = (VkImageLayout)pBarriers[i].newLayout;
-        imageMemoryBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarriers[i].subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarriers[i].subresourceRange.baseMipLevel = 0;
-        imageMemoryBarriers[i].subresourceRange.layerCount = 1;
-        imageMemoryBarriers[i].subresourceRange.levelCount = 1;
+        // The image's command buffer may still be pending from an older frame slot.
+        arWaitFrame(pFrame->frame);
+        pFrame->frame = g.frameCounter + 1;
 
-        if (pBarriers[i].pImage)
+        g.graphicsCommandBufferInfo.commandBuffer = pFrame->cmd;
+
+        if (g.immediateRecording)
         {
-            imageMemoryBarriers[i].image = *pBarriers[i].pImage->handle.data;
+            g.pFrame = pFrame;
+            arRecordFrame();
+            g.graphicsCommandBufferInfo.commandBuffer = g.frameCommandBuffers[g.frameIndex];
         }
-        else
+        g.signalSemaphores[0].semaphore = pFrame->renSemaphore;
+        g.signalSemaphores[1].value = pFrame->frame;
+        g.preSemaphore.semaphore = pFrame->preSemaphore;
+
+        if (g.vkQueueSubmit2(g.graphicsQueue, 1, &g.submitInfo, NULL))
         {
-            imageMemoryBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-            imageMemoryBarriers[i].image = g.pFrame->image;
+            arError("Failed to submit commands");
         }
 
-        if (pBarriers[i].newLayout == AR_IMAGE_LAYOUT_PRESENT_SRC)
+        if (g.headless)
         {
-            imageMemoryBarriers[i].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            g.frameCounter += 1;
+            continue;
+        }
+
+        if (!g.unifiedQueue)
+        {
+            g.presentCommandBufferInfo.commandBuffer = pFrame->presentCmd;
             
-            if (!g.unifiedQueue)
+            if (g.vkQueueSubmit2(g.presentQueue, 1, &g.presentSubmitInfo, NULL))
             {
-                imageMemoryBarriers[i].dstStageMask = VK_PIPELINE_STAGE_2_NONE;
-                imageMemoryBarriers[i].srcQueueFamilyIndex = g.graphicsQueueFamily;
-                imageMemoryBarriers[i].dstQueueFamilyIndex = g.presentQueueFamily;
+                arError("Failed to submit commands");
             }
         }
-        else if (pBarriers[i].oldLayout == AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT ||
-                 pBarriers[i].newLayout == AR_IMAGE_LAYOUT_DEPTH_ATTACHMENT)
+
+#if defined(AR_PLATFORM_WAYLAND)
+        if (g.vsyncEnabled)
         {
-            imageMemoryBarriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            arWaylandRequestFrame();
         }
-    }
+#endif
 
-    VkDependencyInfo dependencyInfo;
-    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    dependencyInfo.pNext = NULL;
-    dependencyInfo.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    dependencyInfo.memoryBarrierCount = 0;
-    dependencyInfo.bufferMemoryBarrierCount = 0;
-    dependencyInfo.imageMemoryBarrierCount = barrierCount;
-    dependencyInfo.pImageMemoryBarriers = imageMemoryBarriers;
-    g.vkCmdPipelineBarrier2(g.pFrame->cmd, &dependencyInfo);
-}
+        // The frame's work was submitted either way, only the present itself may have been dropped.
+        g.presentIdValue = g.frameCounter + 1;
+        g.presentIdSwapchain = g.swapchain;
 
-void
-arCmdDraw(
-    uint32_t vertexCount,
-    uint32_t instanceCount,
-    uint32_t firstVertex,
-    uint32_t firstInstance)
-{
-    g.vkCmdDraw(
-        g.pFrame->cmd,
-        vertexCount,
-        instanceCount,
-        firstVertex,
-        firstInstance);
-}
+        VkResult result = g.vkQueuePresentKHR(g.presentQueue, &g.presentInfo);
 
-void
-arCmdDrawIndirect(
-    ArBuffer const* pBuffer,
-    uint64_t offset,
-    uint32_t drawCount,
-    uint32_t stride)
-{
-    g.vkCmdDrawIndirect(
-        g.pFrame->cmd,
-        *pBuffer->handle.data,
-        offset,
-        drawCount,
-        stride);
-}
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            g.swapchainDirty = true;
+            g.skippedFrameCount += 1;
+            g.presentIdSwapchain = NULL;
+        }
+        else if (result == VK_SUBOPTIMAL_KHR)
+        {
+            g.swapchainDirty = true;
+            g.suboptimalFrameCount += 1;
+        }
+        else if (result)
+        {
+            arError("Failed to present frame");
+        }
 
-void
-arCmdDrawIndirectCount(
-    ArBuffer const* pBuffer,
-    uint64_t offset,
-    ArBuffer const* pCountBuffer,
-    uint64_t countBufferOffset,
-    uint32_t maxDrawCount,
-    uint32_t stride)
-{
-    g.vkCmdDrawIndirectCount(
-        g.pFrame->cmd,
-        *pBuffer->handle.data,
-        offset,
-        *pCountBuffer->handle.data,
-        countBufferOffset,
-        maxDrawCount,
-        stride);
-}
+        g.frameCounter += 1;
+    }
 
-void
-arCmdDrawIndexed(
-    uint32_t indexCount,
-    uint32_t instanceCount,
-    uint32_t firstIndex,
-    int32_t vertexOffset,
-    uint32_t firstInstance)
-{
-    g.vkCmdDrawIndexed(
-        g.pFrame->cmd,
-        indexCount,
-        instanceCount,
-        firstIndex,
-        vertexOffset,
-        firstInstance);
-}
+    g.vkDeviceWaitIdle(g.device);
+    pApplicationInfo->pfnTeardown();
+    arJobsTeardown();
+    arContextTeardown();
 
-void
-arCmdDrawIndexedIndirect(
-    ArBuffer const* pBuffer,
-    uint64_t offset,
-    uint32_t drawCount,
-    uint32_t stride)
-{
-    g.vkCmdDrawIndexedIndirect(
-        g.pFrame->cmd,
-        *pBuffer->handle.data,
-        offset,
-        drawCount,
-        stride);
-}
+    if (!g.headless)
+    {
+        arWindowTeardown();
+    }
 
-void
-arCmdDrawIndexedIndirectCount(
-    ArBuffer const* pBuffer,
-    uint64_t offset,
-    ArBuffer const* pCountBuffer,
-    uint64_t countBufferOffset,
-    uint32_t maxDrawCount,
-    uint32_t stride)
-{
-    g.vkCmdDrawIndexedIndirectCount(
-        g.pFrame->cmd,
-        *pBuffer->handle.data,
-        offset,
-        *pCountBuffer->handle.data,
-        countBufferOffset,
-        maxDrawCount,
-        stride);
+    arTimerTeardown();
 }
 
 void
-arSetWindowTitle(
-    char const* title)
+arSetPresentMode(
+    ArPresentMode presentMode)
 {
-    SetWindowTextA(
-        g.hwnd,
-        title);
-}
+    g.presentModeRequest = presentMode;
 
-void
-arPollEvents(void)
-{
-    for (ArKeyInternal* key = g.keys; key != g.keys + 260; key += 1)
+    if (presentMode != AR_PRESENT_MODE_DEFAULT)
     {
-        key->isPressed  = false;
-        key->isReleased = false;
+        g.vsyncEnabled = presentMode == AR_PRESENT_MODE_FIFO || presentMode == AR_PRESENT_MODE_FIFO_RELAXED;
     }
 
-    g.cursorRelX = 0;
-    g.cursorRelY = 0;
-
-    MSG msg;
-    while (PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE))
+    if (g.headless)
     {
-        TranslateMessage(&msg);
-        DispatchMessageA(&msg);
+        return;
     }
 
-    double now = arGetTime();
-    g.deltaTime = now - g.previousTime;
-    g.previousTime = now;
-
-    POINT cursorPos;
-    GetPhysicalCursorPos(&cursorPos);
-
-    g.cursorDeltaX = cursorPos.x - g.globalCursorX;
-    g.cursorDeltaY = cursorPos.y - g.globalCursorY;
-
-    g.globalCursorX = cursorPos.x;
-    g.globalCursorY = cursorPos.y;
-
-    ScreenToClient(g.hwnd, &cursorPos);
-
-    g.cursorX = cursorPos.x;
-    g.cursorY = cursorPos.y;
-}
-
-void
-arWaitEvents(void)
-{
-    WaitMessage();
-    arPollEvents();
-}
+    // Modes the swapchain was created as compatible with are switched on the next present.
+    VkPresentModeKHR mode = arChoosePresentMode();
 
-void
-arShowCursor(void)
-{
-    while (ShowCursor(true) < 0);
-}
+    for (uint32_t i = g.compatiblePresentModeCount; i--; )
+    {
+        if (g.compatiblePresentModes[i] == mode)
+        {
+            g.presentMode = mode;
+            return;
+        }
+    }
 
-void
-arHideCursor(void)
-{
-    while (ShowCursor(false) >= 0);
+    g.swapchainDirty = true;
 }
 
 void
-arSetCursorPosition(
-    int x,
-    int y)
+arRequestClose(void)
 {
-    SetCursorPos(x, y);
+    g.windowShouldClose = true;
 }
 
-bool
-arIsKeyDown(
-    ArKey key)
+void
+arRequestRedraw(void)
 {
-    return(g.keys[key].isDown);
+    g.redrawRequested = true;
 }
 
-bool
-arIsKeyPressed(
-    ArKey key)
+void
+arAllocTransient(
+    uint64_t size,
+    uint64_t alignment,
+    void** ppData,
+    uint64_t* pAddress)
 {
-    return(g.keys[key].isPressed);
-}
+    alignment = alignment ? alignment : 1;
 
-bool
-arIsKeyReleased(
-    ArKey key)
-{
-    return(g.keys[key].isReleased);
+    uint64_t offset = (g.transientOffset + alignment - 1) & ~(alignment - 1);
+
+    if (offset + size > g.transientSize)
+    {
+        arError("Out of transient memory");
+    }
+
+    g.transientOffset = offset + size;
+    offset += g.frameIndex * g.transientSize;
+
+    *ppData = (char*)g.transientBuffer.pMapped + offset;
+    *pAddress = g.transientBuffer.address + offset;
 }
 
-bool
-arIsButtonDown(
-    ArButton button)
+uint64_t
+arGetCurrentFrame(void)
 {
-    return(g.buttons[button].isDown);
+    return(g.frameCounter + 1);
 }
 
-bool
-arIsButtonPressed(
-    ArButton button)
+uint64_t
+arGetCompletedFrame(void)
 {
-    return(g.buttons[button].isPressed);
+    uint64_t value;
+    arVkCheck(g.vkGetSemaphoreCounterValue(g.device, g.timeline, &value));
+    return(value);
 }
 
-bool
-arIsButtonReleased(
-    ArButton button)
+ArImage const*
+arGetHeadlessImage(
+    uint64_t frame)
 {
-    return(g.buttons[button].isReleased);
+    // An image holds its frame until the frame imageCount later is submitted and renders into it again.
+    if (!g.headless || !frame || frame > g.frameCounter || frame + g.imageCount <= g.frameCounter)
+    {
+        arError("The frame's headless image is not available");
+    }
+
+    return(&g.headlessImages[(frame - 1) % g.imageCount]);
 }
 
-double
-arGetTime(void)
+void
+arReadHeadlessImage(
+    uint64_t frame,
+    void* pData)
 {
-    LARGE_INTEGER value;
-    QueryPerformanceCounter(&value);
+    if (g.uploadBatch)
+    {
+        arError("Headless images can't be read inside an upload batch");
+    }
 
-    return((double)
-        (value.QuadPart - g.timeOffset.QuadPart)
-        / g.timeFrequency.QuadPart);
+    ArImage const* pImage = arGetHeadlessImage(frame);
+    uint64_t size = (uint64_t)pImage->width * pImage->height * 4;
+
+    if (!g.headlessReadback.handle.data[0])
+    {
+        arCreateMappedBuffer(&g.headlessReadback, size, AR_MEMORY_CATEGORY_STAGING, AR_MEMORY_USAGE_READBACK);
+    }
+
+    // Like a buffer resize, the copy is recorded for the graphics queue. It runs behind the frame
+    // that rendered the image and ahead of the next frame that renders into it.
+    arBeginTransfer();
+    VkCommandBuffer cmd = g.dedicatedTransfer ? g.pTransfer->acquireCmd : g.pTransfer->cmd;
+
+    VkMemoryBarrier2 memoryBarrier;
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = NULL;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+
+    VkDependencyInfo dependencyInfo;
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = NULL;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    dependencyInfo.bufferMemoryBarrierCount = 0;
+    dependencyInfo.imageMemoryBarrierCount = 0;
+    g.vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    // Headless frames leave their image in the general layout.
+    VkBufferImageCopy region;
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset.x = 0;
+    region.imageOffset.y = 0;
+    region.imageOffset.z = 0;
+    region.imageExtent.width = pImage->width;
+    region.imageExtent.height = pImage->height;
+    region.imageExtent.depth = 1;
+    g.vkCmdCopyImageToBuffer(
+        cmd, pImage->handle.data[0], VK_IMAGE_LAYOUT_GENERAL,
+        g.headlessReadback.handle.data[0], 1, &region);
+
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_2_HOST_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    g.vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    uint64_t value = arEndUpload();
+    arFlushAcquires(value);
+    arWaitTimeline(g.dedicatedTransfer ? g.acquireTimeline : g.uploadTimeline, value);
+    memcpy(pData, g.headlessReadback.pMapped, size);
 }
 
 double
-arGetDeltaTime(void)
+arGetFrameLatency(void)
 {
-    return(g.deltaTime);
+    return(g.frameLatency);
 }
 
-float
-arGetTimef(void)
+void
+arGetFrameStats(
+    ArFrameStats* pStats)
 {
-    return((float)arGetTime());
+    pStats->frameCount = g.frameCounter;
+    pStats->skippedFrameCount = g.skippedFrameCount;
+    pStats->suboptimalFrameCount = g.suboptimalFrameCount;
+    pStats->swapchainRecreateCount = g.swapchainRecreateCount;
 }
 
-float
-arGetDeltaTimef(void)
+void
+arGetMemoryInfo(
+    ArMemoryInfo* pInfo)
 {
-    return((float)g.deltaTime);
-}
+    for (uint32_t usage = AR_MEMORY_USAGE_COUNT; usage--; )
+    {
+        ArMemoryUsageInfo* pUsage = &pInfo->usages[usage];
+        pUsage->memoryTypeIndex = UINT32_MAX;
+        pUsage->heapIndex = UINT32_MAX;
+        pUsage->propertyFlags = 0;
+        pUsage->heapSize = 0;
 
-uint32_t
-arGetWindowWidth(void)
-{
-    return((uint32_t)g.width);
-}
+        if (g.memoryTypeOrderCount[usage])
+        {
+            VkMemoryType type = g.memoryProperties.memoryTypes[g.memoryTypeOrder[usage][0]];
+            pUsage->memoryTypeIndex = g.memoryTypeOrder[usage][0];
+            pUsage->heapIndex = type.heapIndex;
+            pUsage->propertyFlags = type.propertyFlags;
+            pUsage->heapSize = g.memoryProperties.memoryHeaps[type.heapIndex].size;
+        }
+    }
 
-uint32_t
-arGetWindowHeight(void)
-{
-    return((uint32_t)g.height);
+    pInfo->memoryTypeCount = g.memoryProperties.memoryTypeCount;
+    pInfo->memoryHeapCount = g.memoryProperties.memoryHeapCount;
+    pInfo->unifiedMemory = g.unifiedMemory;
+    pInfo->resizableBar = g.resizableBar;
 }
 
-uint32_t
-arGetRenderWidth(void)
+void
+arGetMemoryStats(
+    ArMemoryStats* pStats)
 {
-    return(g.extent.width);
-}
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    budgetProperties.pNext = NULL;
 
-uint32_t
-arGetRenderHeight(void)
-{
-    return(g.extent.height);
-}
+    VkPhysicalDeviceMemoryProperties2 memoryProperties;
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = &budgetProperties;
 
-int32_t
-arGetWindowPositionX(void)
-{
-    RECT point;
-    GetWindowRect(g.hwnd, &point);
-    return(point.left);
-}
+    if (g.memoryBudget)
+    {
+        g.vkGetPhysicalDeviceMemoryProperties2(g.gpu, &memoryProperties);
+    }
 
-int32_t
-arGetWindowPositionY(void)
-{
-    RECT point;
-    GetWindowRect(g.hwnd, &point);
-    return(point.top);
-}
+    pStats->heapCount = g.memoryProperties.memoryHeapCount;
+    pStats->budgetSupported = g.memoryBudget;
 
-float
-arGetWindowAspectRatio(void)
-{
-    return(g.width / (float)g.height);
-}
+    for (uint32_t i = g.memoryProperties.memoryHeapCount; i--; )
+    {
+        ArMemoryHeapStats* pHeap = &pStats->heaps[i];
+        pHeap->size = g.memoryProperties.memoryHeaps[i].size;
+        pHeap->blockBytes = g.heapBlockBytes[i];
+        pHeap->allocationBytes = g.heapAllocationBytes[i];
 
-float
-arGetRenderAspectRatio(void)
-{
-    return(g.extent.width / (float)g.extent.height);
-}
+        // Without the extension only this process' own blocks are known, the budget is a conservative guess.
+        if (g.memoryBudget)
+        {
+            pHeap->usage = budgetProperties.heapUsage[i];
+            pHeap->budget = budgetProperties.heapBudget[i];
+        }
+        else
+        {
+            pHeap->usage = g.heapBlockBytes[i];
+            pHeap->budget = pHeap->size / 5 * 4;
+        }
+    }
 
-int
-arGetGlobalCursorX(void)
-{
-    return(g.globalCursorX);
-}
+    pStats->blockCount = g.blockCount;
+    pStats->dedicatedBlockCount = g.dedicatedBlockCount;
+    pStats->allocationCount = g.allocationCount;
+    pStats->freeRangeCount = 0;
+    pStats->freeBytes = 0;
+    pStats->largestFreeRange = 0;
 
-int
-arGetGlobalCursorY(void)
-{
-    return(g.globalCursorY);
+    // Free ranges inside blocks, many small ones next to a large free total mean the blocks are fragmented.
+    for (uint32_t i = VK_MAX_MEMORY_TYPES; i--; )
+    {
+        for (uint32_t j = 2; j--; )
+        {
+            ArMemoryPool const* pPool = &g.memoryPools[i][j];
+
+            for (uint32_t fl = AR_TLSF_FL_COUNT; fl--; )
+            {
+                for (uint32_t sl = AR_TLSF_SL_COUNT; sl--; )
+                {
+                    for (ArAllocation const* pFree = pPool->pFree[fl][sl]; pFree; pFree = pFree->pNextFree)
+                    {
+                        pStats->freeRangeCount += 1;
+                        pStats->freeBytes += pFree->size;
+                        pStats->largestFreeRange = max(pStats->largestFreeRange, pFree->size);
+                    }
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = AR_MEMORY_CATEGORY_COUNT; i--; )
+    {
+        pStats->categoryBytes[i] = g.categoryBytes[i];
+    }
 }
 
-int
-arGetCursorX(void)
+void
+arWaitFrame(
+    uint64_t frame)
 {
-    return(g.cursorX);
+    // Frames that were never submitted would never signal.
+    if (frame > g.frameCounter)
+    {
+        frame = g.frameCounter;
+    }
+
+    arWaitTimeline(g.timeline, frame);
 }
 
-int
-arGetCursorY(void)
+bool
+arIsUploadComplete(
+    uint64_t ticket)
 {
-    return(g.cursorY);
+    uint64_t completed;
+    arVkCheck(g.vkGetSemaphoreCounterValue(g.device, g.uploadTimeline, &completed));
+
+    if (completed < ticket)
+    {
+        return(false);
+    }
+
+    arFlushAcquires(completed);
+    return(true);
 }
 
-int
-arGetCursorDeltaX(void)
+void
+arWaitUpload(
+    uint64_t ticket)
 {
-    return(g.cursorDeltaX);
+    // Waiting on the open batch submits what it has recorded so far.
+    if (ticket > g.uploadCounter && g.uploadBatch)
+    {
+        arEndTransfer();
+        arBeginTransfer();
+    }
+
+    // Tickets that were never handed out would never signal.
+    if (ticket > g.uploadCounter)
+    {
+        ticket = g.uploadCounter;
+    }
+
+    arWaitTimeline(g.uploadTimeline, ticket);
+    arFlushAcquires(ticket);
 }
 
-int
-arGetCursorDeltaY(void)
+void
+arBeginUploadBatch(void)
 {
-    return(g.cursorDeltaY);
+    if (g.uploadBatch)
+    {
+        arError("Upload batch already open");
+    }
+
+    arBeginTransfer();
+    g.uploadBatch = true;
 }
 
-int
-arGetRelativeCursorX(void)
+uint64_t
+arEndUploadBatch(void)
 {
-    return(g.cursorRelX);
+    if (!g.uploadBatch)
+    {
+        arError("No upload batch open");
+    }
+
+    g.uploadBatch = false;
+    arEndTransfer();
+    g.transferWaitFrame = 0;
+
+    // Like the synchronous uploads, the batch is ready for any graphics work submitted after it.
+    arFlushAcquires(g.uploadCounter);
+    return(g.uploadCounter);
 }
 
-int
-arGetRelativeCursorY(void)
+void
+arJobSubmit(
+    void (*pfnJob)(void* pData),
+    void* pData,
+    ArJobCounter* pCounter)
 {
-    return(g.cursorRelY);
+    ArJob job;
+    job.pfnJob = pfnJob;
+    job.pfnRange = NULL;
+    job.pData = pData;
+    job.begin = 0;
+    job.end = 0;
+    job.pCounter = pCounter;
+
+    arJobEnqueue(&job);
 }
 
 void
-arExecute(
-    ArApplicationInfo const* pApplicationInfo)
+arJobWait(
+    ArJobCounter* pCounter)
 {
-    g.pfnUpdate = pApplicationInfo->pfnUpdate;
-    g.pfnResize = pApplicationInfo->pfnResize;
-    g.pfnRecordCommands = pApplicationInfo->pfnRecordCommands;
-    g.vsyncEnabled = pApplicationInfo->enableVsync;
-    arWindowCreate(pApplicationInfo->width, pApplicationInfo->height);
-    arContextCreate();
+    uint32_t threadIndex = arJobThreadIndex();
 
-    pApplicationInfo->pfnInit();
-    arRecordCommands(); 
-
-    for (;;)
+    // The waiting thread helps out instead of blocking, so nested waits inside jobs cannot deadlock.
+    while (arAtomicLoad(&pCounter->value) > 0)
     {
-        pApplicationInfo->pfnUpdate();
-
-        if (g.windowShouldClose)
-        {
-            break;
-        }
+        ArJob job;
 
-        if (g.vkWaitForFences(g.device, 1, &g.fence, 0, UINT64_MAX) |
-            g.vkResetFences(g.device, 1, &g.fence))
+        if (arJobFind(threadIndex, &job))
         {
-            arError("Failed to sync");
+            arJobRun(&job);
         }
-
-        switch (pApplicationInfo->pfnUpdateResources())
+        else
         {
-        case AR_REQUEST_NONE:
-            break;
-        case AR_REQUEST_RECORD_COMMANDS:
-            arRecordCommands();
-            break;
-        case AR_REQUEST_VSYNC_DISABLE:
-            arSwapchainRecreate(false);
-            break;
-        case AR_REQUEST_VSYNC_ENABLE:
-            arSwapchainRecreate(true);
-            break;
+            arJobYield();
         }
+    }
+}
 
-        if (g.vkAcquireNextImageKHR(g.device, g.swapchain, UINT64_MAX, g.acqSemaphore.semaphore, NULL, &g.imageIndex))
-        {
-            arError("Failed to acquire image");
-        }
+void
+arParallelFor(
+    uint32_t count,
+    uint32_t groupSize,
+    void (*pfnJob)(void* pData, uint32_t begin, uint32_t end),
+    void* pData)
+{
+    if (!groupSize)
+    {
+        groupSize = max(count / (g.jobThreadCount * 4), 1);
+    }
 
-        g.graphicsCommandBufferInfo.commandBuffer = g.frames[g.imageIndex].cmd;
-        if (g.vkQueueSubmit2(g.graphicsQueue, 1, &g.submitInfo, g.fence))
-        {
-            arError("Failed to submit commands");
-        }
+    ArJobCounter counter;
+    counter.value = 0;
 
-        if (!g.unifiedQueue)
-        {
-            g.presentCommandBufferInfo.commandBuffer = g.frames[g.imageIndex].presentCmd;
-            
-            if (g.vkQueueSubmit2(g.presentQueue, 1, &g.presentSubmitInfo, NULL))
-            {
-                arError("Failed to submit commands");
-            }
-        }
+    ArJob job;
+    job.pfnJob = NULL;
+    job.pfnRange = pfnJob;
+    job.pData = pData;
+    job.pCounter = &counter;
 
-        if (g.vkQueuePresentKHR(g.presentQueue, &g.presentInfo))
-        {
-            arError("Failed to present frame");
-        }
+    for (uint32_t begin = 0; begin < count; begin += groupSize)
+    {
+        job.begin = begin;
+        job.end = min(begin + groupSize, count);
+        arJobEnqueue(&job);
     }
 
-    g.vkDeviceWaitIdle(g.device);
-    pApplicationInfo->pfnTeardown();
-    arContextTeardown();
-    arWindowTeardown();
+    arJobWait(&counter);
+}
+
+uint32_t
+arGetJobThreadCount(void)
+{
+    return(g.jobThreadCount);
+}
+
+uint32_t
+arGetJobThreadIndex(void)
+{
+    return(arJobThreadIndex());
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ARLINE_H
 #define ARLINE_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -246,6 +247,29 @@ typedef enum ArRequest {
     AR_REQUEST_VSYNC_DISABLE                = 0x03
 } ArRequest;
 
+typedef enum ArPresentMode {
+    AR_PRESENT_MODE_DEFAULT                 = 0x00,
+    AR_PRESENT_MODE_FIFO                    = 0x01,
+    AR_PRESENT_MODE_FIFO_RELAXED            = 0x02,
+    AR_PRESENT_MODE_MAILBOX                 = 0x03,
+    AR_PRESENT_MODE_IMMEDIATE               = 0x04
+} ArPresentMode;
+
+typedef enum ArMemoryUsage {
+    AR_MEMORY_USAGE_DEVICE                  = 0x00,
+    AR_MEMORY_USAGE_UPLOAD                  = 0x01,
+    AR_MEMORY_USAGE_READBACK                = 0x02,
+    AR_MEMORY_USAGE_TRANSIENT               = 0x03,
+    AR_MEMORY_USAGE_STAGING                 = 0x04
+} ArMemoryUsage;
+
+typedef enum ArMemoryCategory {
+    AR_MEMORY_CATEGORY_STATIC_BUFFER        = 0x00,
+    AR_MEMORY_CATEGORY_DYNAMIC_BUFFER       = 0x01,
+    AR_MEMORY_CATEGORY_IMAGE                = 0x02,
+    AR_MEMORY_CATEGORY_STAGING              = 0x03
+} ArMemoryCategory;
+
 typedef struct ArImageHandle {
     void*                                   data[3];
 } ArImageHandle;
@@ -262,6 +286,14 @@ typedef struct ArPipelineHandle {
     void*                                   data;
 } ArPipelineHandle;
 
+typedef struct ArCmdHandle {
+    void*                                   data;
+} ArCmdHandle;
+
+typedef struct ArJobCounter {
+    int64_t                                 value;
+} ArJobCounter;
+
 typedef union ArClearColor {
     float                                   float32[4];
     uint32_t                                uint32[4];
@@ -296,6 +328,53 @@ typedef struct ArPipeline {
     ArPipelineHandle                        handle;
 } ArPipeline;
 
+typedef struct ArCmd {
+    ArCmdHandle                             handle;
+} ArCmd;
+
+typedef struct ArFrameStats {
+    uint64_t                                frameCount;
+    uint64_t                                skippedFrameCount;
+    uint64_t                                suboptimalFrameCount;
+    uint64_t                                swapchainRecreateCount;
+} ArFrameStats;
+
+typedef struct ArMemoryUsageInfo {
+    uint32_t                                memoryTypeIndex;
+    uint32_t                                heapIndex;
+    uint32_t                                propertyFlags;
+    uint64_t                                heapSize;
+} ArMemoryUsageInfo;
+
+typedef struct ArMemoryInfo {
+    ArMemoryUsageInfo                       usages[5];
+    uint32_t                                memoryTypeCount;
+    uint32_t                                memoryHeapCount;
+    bool                                    unifiedMemory;
+    bool                                    resizableBar;
+} ArMemoryInfo;
+
+typedef struct ArMemoryHeapStats {
+    uint64_t                                size;
+    uint64_t                                budget;
+    uint64_t                                usage;
+    uint64_t                                blockBytes;
+    uint64_t                                allocationBytes;
+} ArMemoryHeapStats;
+
+typedef struct ArMemoryStats {
+    ArMemoryHeapStats                       heaps[16];
+    uint32_t                                heapCount;
+    bool                                    budgetSupported;
+    uint32_t                                blockCount;
+    uint32_t                                dedicatedBlockCount;
+    uint32_t                                allocationCount;
+    uint32_t                                freeRangeCount;
+    uint64_t                                freeBytes;
+    uint64_t                                largestFreeRange;
+    uint64_t                                categoryBytes[4];
+} ArMemoryStats;
+
 typedef struct ArApplicationInfo {
     void                                    (*pfnInit)();
     void                                    (*pfnTeardown)();
@@ -306,6 +385,18 @@ typedef struct ArApplicationInfo {
     int                                     width;
     int                                     height;
     bool                                    enableVsync;
+    ArPresentMode                           presentMode;
+    uint32_t                                swapchainImageCount;
+    double                                  targetFrameRate;
+    bool                                    onDemandRendering;
+    uint32_t                                framesInFlight;
+    uint64_t                                transientMemorySize;
+    bool                                    immediateRecording;
+    bool                                    lowLatency;
+    uint32_t                                jobThreadCount;
+    bool                                    headless;
+    uint32_t                                headlessFrameCount;
+    double                                  headlessTimeStep;
 } ArApplicationInfo;
 
 typedef struct ArAttachment {
@@ -433,6 +524,42 @@ void arSetCursorPosition(
 void arExecute(
     ArApplicationInfo const*                pApplicationInfo);
 
+void arRequestClose(void);
+void arRequestRedraw(void);
+
+void arSetPresentMode(
+    ArPresentMode                           presentMode);
+
+uint64_t arGetCurrentFrame(void);
+uint64_t arGetCompletedFrame(void);
+
+ArImage const* arGetHeadlessImage(
+    uint64_t                                frame);
+
+void arReadHeadlessImage(
+    uint64_t                                frame,
+    void*                                   pData);
+
+void arGetFrameStats(
+    ArFrameStats*                           pStats);
+
+double arGetFrameLatency(void);
+
+void arGetMemoryInfo(
+    ArMemoryInfo*                           pInfo);
+
+void arGetMemoryStats(
+    ArMemoryStats*                          pStats);
+
+void arWaitFrame(
+    uint64_t                                frame);
+
+void arAllocTransient(
+    uint64_t                                size,
+    uint64_t                                alignment,
+    void**                                  ppData,
+    uint64_t*                               pAddress);
+
 void arSetWindowTitle(
     char const*                             title);
 
@@ -445,21 +572,62 @@ void arCreateStaticBuffer(
     uint64_t                                size,
     void const*                             pData);
 
+void arUpdateBuffer(
+    ArBuffer const*                         pBuffer,
+    uint64_t                                offset,
+    uint64_t                                size,
+    void const*                             pData);
+
+uint64_t arResizeBuffer(
+    ArBuffer*                               pBuffer,
+    uint64_t                                size);
+
 void arDestroyBuffer(
     ArBuffer const*                         pBuffer);
 
+void arDestroyBufferDeferred(
+    ArBuffer const*                         pBuffer);
+
 void arCreateImage(
     ArImage*                                pImage,
     ArImageCreateInfo const*                pImageCreateInfo);
 
+void arCreateTransientImage(
+    ArImage*                                pImage,
+    ArImageCreateInfo const*                pImageCreateInfo,
+    uint32_t                                aliasSlot);
+
 void arUpdateImage(
     ArImage*                                pImage,
     size_t                                  dataSize,
     void const*                             pData);
 
+uint64_t arUploadBufferAsync(
+    ArBuffer const*                         pBuffer,
+    uint64_t                                offset,
+    uint64_t                                size,
+    void const*                             pData);
+
+uint64_t arUploadImageAsync(
+    ArImage const*                          pImage,
+    size_t                                  dataSize,
+    void const*                             pData);
+
+bool arIsUploadComplete(
+    uint64_t                                ticket);
+
+void arWaitUpload(
+    uint64_t                                ticket);
+
+void arBeginUploadBatch(void);
+uint64_t arEndUploadBatch(void);
+
 void arDestroyImage(
     ArImage const*                          pImage);
 
+void arDestroyImageDeferred(
+    ArImage const*                          pImage);
+
 void arCreateShaderFromFile(
     ArShader*                               pShader,
     char const*                             filename);
@@ -479,6 +647,9 @@ void arCreateGraphicsPipeline(
 void arDestroyPipeline(
     ArPipeline const*                       pPipeline);
 
+void arDestroyPipelineDeferred(
+    ArPipeline const*                       pPipeline);
+
 void arCmdBeginRendering(
     uint32_t                                colorAttachmentCount,
     ArAttachment const*                     pColorAttachments,
@@ -544,6 +715,93 @@ void arCmdDrawIndexedIndirectCount(
     uint32_t                                maxDrawCount,
     uint32_t                                stride);
 
+void arBeginParallelRecording(
+    uint32_t                                cmdCount,
+    ArCmd*                                  pCmds);
+
+void arEndParallelRecording(void);
+
+void arCmdPushConstantsEx(
+    ArCmd const*                            pCmd,
+    uint32_t                                offset,
+    uint32_t                                size,
+    void const*                             pValues);
+
+void arCmdBindIndexBufferEx(
+    ArCmd const*                            pCmd,
+    ArBuffer const*                         pBuffer,
+    uint64_t                                offset,
+    ArIndexType                             indexType);
+
+void arCmdBindGraphicsPipelineEx(
+    ArCmd const*                            pCmd,
+    ArPipeline const*                       pPipeline);
+
+void arCmdDrawEx(
+    ArCmd const*                            pCmd,
+    uint32_t                                vertexCount,
+    uint32_t                                instanceCount,
+    uint32_t                                firstVertex,
+    uint32_t                                firstInstance);
+
+void arCmdDrawIndirectEx(
+    ArCmd const*                            pCmd,
+    ArBuffer const*                         pBuffer,
+    uint64_t                                offset,
+    uint32_t                                drawCount,
+    uint32_t                                stride);
+
+void arCmdDrawIndirectCountEx(
+    ArCmd const*                            pCmd,
+    ArBuffer const*                         pBuffer,
+    uint64_t                                offset,
+    ArBuffer const*                         pCountBuffer,
+    uint64_t                                countBufferOffset,
+    uint32_t                                maxDrawCount,
+    uint32_t                                stride);
+
+void arCmdDrawIndexedEx(
+    ArCmd const*                            pCmd,
+    uint32_t                                indexCount,
+    uint32_t                                instanceCount,
+    uint32_t                                firstIndex,
+    int32_t                                 vertexOffset,
+    uint32_t                                firstInstance);
+
+void arCmdDrawIndexedIndirectEx(
+    ArCmd const*                            pCmd,
+    ArBuffer const*                         pBuffer,
+    uint64_t                                offset,
+    uint32_t                                drawCount,
+    uint32_t                                stride);
+
+void arCmdDrawIndexedIndirectCountEx(
+    ArCmd const*                            pCmd,
+    ArBuffer const*                         pBuffer,
+    uint64_t                                offset,
+    ArBuffer const*                         pCountBuffer,
+    uint64_t                                countBufferOffset,
+    uint32_t                                maxDrawCount,
+    uint32_t                                stride);
+
+void arJobSubmit(
+    void                                    (*pfnJob)(void* pData),
+    void*                                   pData,
+    ArJobCounter*                           pCounter);
+
+void arJobWait(
+    ArJobCounter*                           pCounter);
+
+void arParallelFor(
+    uint32_t                                count,
+    uint32_t                                groupSize,
+    void                                    (*pfnJob)(void* pData, uint32_t begin, uint32_t end),
+    void*                                   pData);
+
+uint32_t arGetJobThreadCount(void);
+
+uint32_t arGetJobThreadIndex(void);
+
 #ifdef __cplusplus
 }
 #endif
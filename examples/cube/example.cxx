@@ -12,7 +12,7 @@ struct SceneData
 };
 
 static ArImage colorFb, depthFb;
-static ArBuffer positionBuffer, colorBuffer, sceneBuffer;
+static ArBuffer positionBuffer, colorBuffer;
 static ArPipeline cubePipeline, finalImagePipeline;
 static SceneData sceneData;
 
@@ -26,22 +26,22 @@ createPerSwapchainResources()
             .dstArrayElement = 1
         };
 
-        arCreateImage(&colorFb, &colorFbCreateInfo);
+        arCreateTransientImage(&colorFb, &colorFbCreateInfo, 0);
     }
     {
         ArImageCreateInfo const depthFbCreateInfo = {
             .usage = AR_IMAGE_USAGE_DEPTH_ATTACHMENT
         };
 
-        arCreateImage(&depthFb, &depthFbCreateInfo);
+        arCreateTransientImage(&depthFb, &depthFbCreateInfo, 1);
     }
 }
 
 static void
 destroyPerSwapchainResources()
 {
-    arDestroyImage(&depthFb);
-    arDestroyImage(&colorFb);
+    arDestroyImageDeferred(&depthFb);
+    arDestroyImageDeferred(&colorFb);
 }
 
 static void
@@ -50,7 +50,6 @@ init()
     createPerSwapchainResources();
     arCreateStaticBuffer(&positionBuffer, sizeof(cubePositions), cubePositions);
     arCreateStaticBuffer(&colorBuffer, sizeof(cubeColors), cubeColors);
-    arCreateDynamicBuffer(&sceneBuffer, sizeof(sceneBuffer));
 
     ArShader vertShader;
     ArShader fragShader;
@@ -99,7 +98,6 @@ teardown()
 {
     arDestroyPipeline(&finalImagePipeline);
     arDestroyPipeline(&cubePipeline);
-    arDestroyBuffer(&sceneBuffer);
     arDestroyBuffer(&colorBuffer);
     arDestroyBuffer(&positionBuffer);
     destroyPerSwapchainResources();
@@ -133,7 +131,6 @@ update()
 static ArRequest
 updateResources()
 {
-    memcpy(sceneBuffer.pMapped, &sceneData, sizeof(sceneData));
     return AR_REQUEST_NONE;
 }
 
@@ -147,10 +144,15 @@ resize()
 static void
 recordCommands()
 {
+    void* pSceneData;
+    uint64_t sceneAddress;
+    arAllocTransient(sizeof(sceneData), 16, &pSceneData, &sceneAddress);
+    memcpy(pSceneData, &sceneData, sizeof(sceneData));
+
     uint64_t const pushConstant[] = {
         positionBuffer.address,
         colorBuffer.address,
-        sceneBuffer.address
+        sceneAddress
     };
 
     {
@@ -238,7 +240,8 @@ main()
         .pfnUpdateResources = updateResources,
         .width = 1280,
         .height = 720,
-        .enableVsync = false
+        .enableVsync = false,
+        .immediateRecording = true
     };
 
     arExecute(&applicationInfo);
@@ -129,6 +129,18 @@ main(void)
     applicationInfo.width = 1280;
     applicationInfo.height = 720;
     applicationInfo.enableVsync = true;
+    applicationInfo.presentMode = AR_PRESENT_MODE_DEFAULT;
+    applicationInfo.swapchainImageCount = 0;
+    applicationInfo.targetFrameRate = 0.0;
+    applicationInfo.onDemandRendering = false;
+    applicationInfo.framesInFlight = 2;
+    applicationInfo.transientMemorySize = 0;
+    applicationInfo.immediateRecording = false;
+    applicationInfo.lowLatency = false;
+    applicationInfo.jobThreadCount = 0;
+    applicationInfo.headless = false;
+    applicationInfo.headlessFrameCount = 0;
+    applicationInfo.headlessTimeStep = 0.0;
 
     arExecute(&applicationInfo);
     ExitProcess(0);